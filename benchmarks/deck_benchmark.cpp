@@ -0,0 +1,211 @@
+#include "perf_counters.h"
+#include "the_deck.h"
+#include <benchmark/benchmark.h>
+#include <string>
+
+using benchmark::Counter;
+using benchmark::DoNotOptimize;
+using benchmark::State;
+using std::string;
+using std::vector;
+
+using namespace The_Deck;
+
+namespace {
+// Mostly letters, with the spaces and punctuation real text has, so the
+// normalizer has something to throw away.
+string sample_text(const size_t size)
+{
+    static const string pattern = "Attack at dawn, bring the maps! 0600 hrs; "
+                                  "the quick brown fox jumps over a lazy dog. ";
+    string text;
+    text.reserve(size);
+    while (text.size() < size)
+        text += pattern;
+    text.resize(size);
+    return text;
+}
+
+Deck shuffled_deck()
+{
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle(std::mt19937 { 20261017 });
+    return deck;
+}
+
+// Reports values per second (cards, keystream values, letters) and, where
+// the operation has an input to speak of, bytes per second.
+void report(State& state, const size_t values_per_iteration,
+    const size_t bytes_per_iteration = 0)
+{
+    const auto iterations = static_cast<double>(state.iterations());
+    state.counters["values/s"] = Counter(iterations * static_cast<double>(values_per_iteration),
+        Counter::kIsRate);
+    if (bytes_per_iteration)
+        state.counters["bytes/s"] = Counter(iterations * static_cast<double>(bytes_per_iteration),
+            Counter::kIsRate, Counter::kIs1024);
+}
+
+void BM_DeckConstruct(State& state)
+{
+    for (auto _ : state) {
+        auto deck = Deck(Deck::Kind::WITH_JOKERS);
+        DoNotOptimize(deck);
+    }
+    report(state, Deck::MAX_CARDS, sizeof(Deck));
+}
+BENCHMARK(BM_DeckConstruct);
+
+void BM_DeckCopy(State& state)
+{
+    const auto deck = shuffled_deck();
+    for (auto _ : state) {
+        auto copy = deck;
+        DoNotOptimize(copy);
+    }
+    report(state, Deck::MAX_CARDS, sizeof(Deck));
+}
+BENCHMARK(BM_DeckCopy);
+
+void BM_Shuffle(State& state)
+{
+    auto deck = shuffled_deck();
+    for (auto _ : state) {
+        deck.shuffle();
+        DoNotOptimize(deck);
+    }
+    report(state, Deck::MAX_CARDS, sizeof(Deck));
+}
+BENCHMARK(BM_Shuffle);
+
+void BM_TripleCut(State& state)
+{
+    auto deck = shuffled_deck();
+    for (auto _ : state) {
+        deck.triple_cut();
+        DoNotOptimize(deck);
+    }
+    report(state, 1);
+}
+BENCHMARK(BM_TripleCut);
+
+void BM_CountCut(State& state)
+{
+    auto deck = shuffled_deck();
+    for (auto _ : state) {
+        deck.count_cut();
+        DoNotOptimize(deck);
+    }
+    report(state, 1);
+}
+BENCHMARK(BM_CountCut);
+
+void BM_BuryJokerA(State& state)
+{
+    auto deck = shuffled_deck();
+    for (auto _ : state) {
+        deck.bury_joker_a();
+        DoNotOptimize(deck);
+    }
+    report(state, 1);
+}
+BENCHMARK(BM_BuryJokerA);
+
+void BM_BuryJokerB(State& state)
+{
+    auto deck = shuffled_deck();
+    for (auto _ : state) {
+        deck.bury_joker_b();
+        DoNotOptimize(deck);
+    }
+    report(state, 1);
+}
+BENCHMARK(BM_BuryJokerB);
+
+void BM_GetKeystreamValue(State& state)
+{
+    auto deck = shuffled_deck();
+    for (auto _ : state)
+        DoNotOptimize(get_keystream_value(deck));
+    report(state, 1);
+}
+BENCHMARK(BM_GetKeystreamValue);
+
+template <size_t N>
+void BM_SizedDeckStep(State& state)
+{
+    SizedDeck<N> deck;
+    deck.shuffle(std::mt19937 { 20261017 });
+    for (auto _ : state)
+        DoNotOptimize(deck.step());
+    report(state, 1);
+}
+BENCHMARK(BM_SizedDeckStep<10>);
+BENCHMARK(BM_SizedDeckStep<26>);
+BENCHMARK(BM_SizedDeckStep<54>);
+
+void BM_KeystreamGenerator(State& state)
+{
+    KeystreamGenerator generator(shuffled_deck());
+    vector<uint8_t> keystream(4096);
+    for (auto _ : state) {
+        generator.generate(keystream);
+        DoNotOptimize(keystream.data());
+    }
+    report(state, keystream.size());
+}
+BENCHMARK(BM_KeystreamGenerator);
+
+template <size_t Lanes>
+void BM_LaneEngine(State& state)
+{
+    vector<Deck> decks;
+    for (size_t lane = 0; lane < Lanes; lane++)
+        decks.push_back(shuffled_deck());
+    for (size_t lane = 0; lane < Lanes; lane++)
+        decks[lane].shuffle(std::mt19937 { static_cast<uint32_t>(lane) });
+    LaneEngine<Lanes> lanes(decks);
+    vector<uint8_t> keystream(Lanes * 512);
+    for (auto _ : state) {
+        lanes.generate(keystream);
+        DoNotOptimize(keystream.data());
+    }
+    report(state, keystream.size());
+}
+BENCHMARK(BM_LaneEngine<8>);
+BENCHMARK(BM_LaneEngine<16>);
+BENCHMARK(BM_LaneEngine<32>);
+
+void BM_ConvertStringToUint8(State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    const auto text = sample_text(size);
+    for (auto _ : state)
+        DoNotOptimize(convert_string_to_uint8(text));
+    report(state, size, size);
+}
+BENCHMARK(BM_ConvertStringToUint8)->RangeMultiplier(8)->Range(16, 64 << 20);
+
+void crypt_benchmark(State& state, const Opmode mode)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    const auto text = sample_text(size);
+    const auto deck = shuffled_deck();
+    const auto letters = convert_string_to_uint8(text).size();
+
+    Bench::PerfCounters counters;
+    counters.start();
+    for (auto _ : state)
+        DoNotOptimize(crypt(text, deck, mode));
+    counters.stop(state, static_cast<double>(state.iterations()) * static_cast<double>(size));
+    report(state, letters, size);
+}
+
+void BM_Encrypt(State& state) { crypt_benchmark(state, Opmode::ENCRYPT); }
+BENCHMARK(BM_Encrypt)->RangeMultiplier(8)->Range(16, 64 << 20)->Unit(benchmark::kMicrosecond);
+
+void BM_Decrypt(State& state) { crypt_benchmark(state, Opmode::DECRYPT); }
+BENCHMARK(BM_Decrypt)->RangeMultiplier(8)->Range(16, 64 << 20)->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_MAIN();
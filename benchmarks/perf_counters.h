@@ -0,0 +1,101 @@
+#ifndef DECKY_BENCHMARKS_PERF_COUNTERS_H
+#define DECKY_BENCHMARKS_PERF_COUNTERS_H
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* Optional hardware counters for the benchmarks: cycles and instructions
+ * retired, read through perf_event_open. Where the kernel won't allow it
+ * (in many containers, or with a strict perf_event_paranoid) or on
+ * other platforms, the counters quietly stay off and the benchmarks run
+ * as usual. */
+
+namespace Bench {
+class PerfCounters {
+public:
+    PerfCounters()
+    {
+#ifdef __linux__
+        cycles = open_counter(PERF_COUNT_HW_CPU_CYCLES, -1);
+        if (cycles >= 0)
+            instructions = open_counter(PERF_COUNT_HW_INSTRUCTIONS, cycles);
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        if (instructions >= 0)
+            ::close(instructions);
+        if (cycles >= 0)
+            ::close(cycles);
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return instructions >= 0; }
+
+    void start()
+    {
+#ifdef __linux__
+        if (!available())
+            return;
+        ::ioctl(cycles, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ::ioctl(cycles, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    /* Stops counting and reports cycles and instructions per byte of
+     * input alongside the benchmark's own figures. */
+    void stop(benchmark::State& state, const double bytes)
+    {
+#ifdef __linux__
+        if (!available() || bytes <= 0)
+            return;
+        ::ioctl(cycles, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        struct {
+            uint64_t count;
+            uint64_t values[2];
+        } group {};
+        if (::read(cycles, &group, sizeof(group)) != sizeof(group) || group.count != 2)
+            return;
+        state.counters["cycles/byte"] = static_cast<double>(group.values[0]) / bytes;
+        state.counters["insns/byte"] = static_cast<double>(group.values[1]) / bytes;
+        if (group.values[0])
+            state.counters["IPC"] = static_cast<double>(group.values[1]) / static_cast<double>(group.values[0]);
+#else
+        (void)state;
+        (void)bytes;
+#endif
+    }
+
+private:
+    int cycles { -1 };
+    int instructions { -1 };
+
+#ifdef __linux__
+    static int open_counter(const uint64_t config, const int group)
+    {
+        perf_event_attr attr {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.disabled = group < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+    }
+#endif
+};
+} // namespace Bench
+#endif
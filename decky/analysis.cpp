@@ -0,0 +1,237 @@
+#include "the_deck.h"
+#include "thread_pool.h"
+#include <cmath>
+
+using std::array;
+using std::function;
+using std::invalid_argument;
+using std::lock_guard;
+using std::max;
+using std::min;
+using std::mutex;
+using std::span;
+using std::vector;
+
+namespace The_Deck {
+namespace {
+    // The serialized analysis: a magic number, a format version, and then
+    // every field in order as a little-endian 64-bit number.
+    constexpr array<uint8_t, 4> ANALYSIS_MAGIC { 'D', 'K', 'S', 'T' };
+    constexpr uint8_t ANALYSIS_VERSION = 1;
+    constexpr size_t ANALYSIS_FIELDS = 4 + 26 + 26 * 26 + KeystreamAnalysis::GAP_BUCKETS;
+    constexpr size_t ANALYSIS_SIZE = ANALYSIS_MAGIC.size() + 1 + 8 * ANALYSIS_FIELDS;
+
+    // Roughly how many values one task takes, and how many tasks each
+    // thread gets per round.
+    constexpr uint64_t VALUES_PER_TASK = 1 << 20;
+    constexpr size_t TASKS_PER_THREAD = 16;
+
+    // One thread's counts for the decks it's working through.
+    struct Histograms {
+        array<uint64_t, 26> unigrams {};
+        array<uint64_t, 26 * 26> bigrams {};
+        array<uint64_t, KeystreamAnalysis::GAP_BUCKETS> gaps {};
+    };
+
+    // Deck number `index` of the run with the given seed.
+    Deck nth_deck(const uint64_t seed, const uint64_t index)
+    {
+        std::seed_seq sequence { static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+            static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32) };
+        auto deck = Deck(Deck::Kind::WITH_JOKERS);
+        deck.shuffle(std::mt19937_64(sequence));
+        return deck;
+    }
+
+    void count_deck(const Deck& deck, uint64_t values, Histograms& counts)
+    {
+        KeystreamGenerator generator(deck);
+        array<uint8_t, 4096> block;
+        // Where each value was last seen, counting from one, or zero if
+        // it hasn't been yet.
+        array<uint64_t, 26> last {};
+        uint64_t position = 0;
+        size_t previous = 0;
+
+        while (values > 0) {
+            const auto size = static_cast<size_t>(min<uint64_t>(values, block.size()));
+            generator.generate(span(block).first(size));
+            for (size_t i = 0; i < size; i++) {
+                const size_t value = block[i] - 1u;
+                counts.unigrams[value] += 1;
+                if (position > 0)
+                    counts.bigrams[previous * 26 + value] += 1;
+                if (last[value] > 0) {
+                    const auto gap = min<uint64_t>(position + 1 - last[value], KeystreamAnalysis::GAP_BUCKETS);
+                    counts.gaps[gap - 1] += 1;
+                }
+                last[value] = ++position;
+                previous = value;
+            }
+            values -= size;
+        }
+    }
+
+    template <size_t N>
+    void add(array<uint64_t, N>& total, const array<uint64_t, N>& counts)
+    {
+        for (size_t i = 0; i < N; i++)
+            total[i] += counts[i];
+    }
+
+    // Sums (observed - expected)^2 / expected over a histogram, with the
+    // expected count for each bucket from `expected(i)`.
+    template <size_t N, typename Expected>
+    ChiSquare chi_square(const array<uint64_t, N>& observed, Expected expected)
+    {
+        ChiSquare result { 0, N - 1 };
+        for (size_t i = 0; i < N; i++) {
+            const auto e = expected(i);
+            if (e > 0) {
+                const auto difference = static_cast<double>(observed[i]) - e;
+                result.statistic += difference * difference / e;
+            }
+        }
+        return result;
+    }
+
+    template <size_t N>
+    double total(const array<uint64_t, N>& counts)
+    {
+        double sum = 0;
+        for (const auto count : counts)
+            sum += static_cast<double>(count);
+        return sum;
+    }
+}
+
+double ChiSquare::z_score() const
+{
+    if (degrees_of_freedom == 0)
+        return 0;
+    const auto k = static_cast<double>(degrees_of_freedom);
+    const auto spread = 2 / (9 * k);
+    return (std::cbrt(statistic / k) - (1 - spread)) / std::sqrt(spread);
+}
+
+ChiSquare KeystreamAnalysis::unigram_chi_square() const
+{
+    const auto each = total(unigrams) / 26;
+    return chi_square(unigrams, [&](size_t) { return each; });
+}
+
+ChiSquare KeystreamAnalysis::bigram_chi_square() const
+{
+    const auto each = total(bigrams) / (26 * 26);
+    return chi_square(bigrams, [&](size_t) { return each; });
+}
+
+ChiSquare KeystreamAnalysis::gap_chi_square() const
+{
+    // For independent, uniform values, a gap of g turns up at any one
+    // place with probability p(1 - p)^(g - 1). Gaps are only counted
+    // within a deck, though, so a deck of L values has room for a gap of
+    // g at just L - g places, and the last bucket takes the tail of
+    // those: sum (L - g) p (1 - p)^(g - 1) for g from GAP_BUCKETS to L - 1.
+    constexpr double p = 1.0 / 26;
+    constexpr double q = 1 - p;
+    const auto values = static_cast<double>(values_per_deck);
+    array<double, GAP_BUCKETS> weights {};
+    for (size_t i = 0; i + 1 < GAP_BUCKETS; i++) {
+        const auto room = values - static_cast<double>(i + 1);
+        weights[i] = room > 0 ? room * p * std::pow(q, static_cast<double>(i)) : 0;
+    }
+    const auto room = values - static_cast<double>(GAP_BUCKETS);
+    if (room > 0)
+        weights[GAP_BUCKETS - 1] = p * std::pow(q, static_cast<double>(GAP_BUCKETS - 1))
+            * (room - (room + 1) * q + std::pow(q, room + 1)) / (p * p);
+
+    double weight = 0;
+    for (const auto w : weights)
+        weight += w;
+    const auto sum = total(gaps);
+    return chi_square(gaps, [&](const size_t i) { return weight > 0 ? sum * weights[i] / weight : 0; });
+}
+
+vector<uint8_t> KeystreamAnalysis::serialize() const
+{
+    vector<uint8_t> data(ANALYSIS_MAGIC.begin(), ANALYSIS_MAGIC.end());
+    data.reserve(ANALYSIS_SIZE);
+    data.push_back(ANALYSIS_VERSION);
+    const auto put = [&](const uint64_t field) {
+        for (size_t byte = 0; byte < 8; byte++)
+            data.push_back(static_cast<uint8_t>(field >> (8 * byte)));
+    };
+    for (const auto field : { seed, values_per_deck, decks, samples })
+        put(field);
+    for (const auto count : unigrams)
+        put(count);
+    for (const auto count : bigrams)
+        put(count);
+    for (const auto count : gaps)
+        put(count);
+    return data;
+}
+
+KeystreamAnalysis KeystreamAnalysis::deserialize(const span<const uint8_t> data)
+{
+    if (data.size() != ANALYSIS_SIZE
+        || !std::equal(ANALYSIS_MAGIC.begin(), ANALYSIS_MAGIC.end(), data.begin())
+        || data[4] != ANALYSIS_VERSION)
+        throw invalid_argument("KeystreamAnalysis: not a keystream analysis");
+
+    size_t offset = ANALYSIS_MAGIC.size() + 1;
+    const auto get = [&] {
+        uint64_t field = 0;
+        for (size_t byte = 0; byte < 8; byte++)
+            field |= static_cast<uint64_t>(data[offset++]) << (8 * byte);
+        return field;
+    };
+    KeystreamAnalysis analysis;
+    analysis.seed = get();
+    analysis.values_per_deck = get();
+    analysis.decks = get();
+    analysis.samples = get();
+    for (auto& count : analysis.unigrams)
+        count = get();
+    for (auto& count : analysis.bigrams)
+        count = get();
+    for (auto& count : analysis.gaps)
+        count = get();
+    return analysis;
+}
+
+void analyze_keystream(KeystreamAnalysis& analysis, const uint64_t decks,
+    const function<void(const KeystreamAnalysis&)>& checkpoint)
+{
+    if (analysis.values_per_deck == 0)
+        throw invalid_argument("analyze_keystream: the analysis takes no values from each deck");
+
+    const auto pool = detail::shared_pool();
+    const auto decks_per_task = max<uint64_t>(VALUES_PER_TASK / analysis.values_per_deck, 1);
+    const auto decks_per_round = decks_per_task * TASKS_PER_THREAD * pool->size();
+    mutex merge_mutex;
+
+    while (analysis.decks < decks) {
+        const auto first = analysis.decks;
+        const auto round = min(decks - first, decks_per_round);
+        const auto tasks = static_cast<size_t>((round + decks_per_task - 1) / decks_per_task);
+        pool->parallel_for(tasks, [&](const size_t task) {
+            Histograms counts;
+            const auto begin = first + task * decks_per_task;
+            const auto end = min(begin + decks_per_task, first + round);
+            for (auto deck = begin; deck < end; deck++)
+                count_deck(nth_deck(analysis.seed, deck), analysis.values_per_deck, counts);
+
+            const lock_guard<mutex> lock(merge_mutex);
+            add(analysis.unigrams, counts.unigrams);
+            add(analysis.bigrams, counts.bigrams);
+            add(analysis.gaps, counts.gaps);
+        });
+        analysis.decks += round;
+        analysis.samples += round * analysis.values_per_deck;
+        if (checkpoint)
+            checkpoint(analysis);
+    }
+}
+} // namespace The_Deck
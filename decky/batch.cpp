@@ -0,0 +1,92 @@
+#include "the_deck.h"
+#include "thread_pool.h"
+#include <memory>
+#include <string>
+#include <thread>
+
+using std::length_error;
+using std::lock_guard;
+using std::make_shared;
+using std::mutex;
+using std::shared_ptr;
+using std::span;
+using std::string;
+using The_Deck::detail::ThreadPool;
+
+namespace The_Deck {
+namespace {
+    struct BatchPool {
+        mutex pool_mutex;
+        size_t requested { 0 };
+        shared_ptr<ThreadPool> pool;
+    };
+
+    BatchPool& batch_pool()
+    {
+        static BatchPool pool;
+        return pool;
+    }
+
+    size_t thread_count(const size_t requested)
+    {
+        if (requested)
+            return requested;
+        return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    void run_job(CryptJob& job)
+    {
+        thread_local string formatted;
+        formatted.clear();
+        SolitaireContext context(job.deck, job.mode);
+        context.update(job.input, formatted);
+        context.finalize(formatted);
+        std::copy(formatted.begin(), formatted.end(), job.output.begin());
+        job.written = formatted.size();
+    }
+}
+
+namespace detail {
+    shared_ptr<ThreadPool> shared_pool()
+    {
+        auto& batch = batch_pool();
+        const lock_guard<mutex> lock(batch.pool_mutex);
+        if (!batch.pool)
+            batch.pool = make_shared<ThreadPool>(thread_count(batch.requested));
+        return batch.pool;
+    }
+}
+
+size_t crypt_output_bound(const size_t input_size)
+{
+    const auto padded = (input_size + 4) / 5 * 5;
+    return padded + padded / 5;
+}
+
+void crypt_batch(const span<CryptJob> jobs)
+{
+    for (const auto& job : jobs)
+        if (job.output.size() < crypt_output_bound(job.input.size()))
+            throw length_error("crypt_batch: a job's output buffer is too small");
+
+    const auto pool = detail::shared_pool();
+    pool->parallel_for(jobs.size(), [&](const size_t i) { run_job(jobs[i]); });
+}
+
+void set_batch_threads(const size_t threads)
+{
+    auto& batch = batch_pool();
+    const lock_guard<mutex> lock(batch.pool_mutex);
+    if (batch.requested == threads && batch.pool)
+        return;
+    batch.requested = threads;
+    batch.pool.reset();
+}
+
+size_t batch_threads()
+{
+    auto& batch = batch_pool();
+    const lock_guard<mutex> lock(batch.pool_mutex);
+    return batch.pool ? batch.pool->size() : thread_count(batch.requested);
+}
+} // namespace The_Deck
@@ -0,0 +1,161 @@
+#include "cache.h"
+#include "lru_cache.h"
+#include "ordinals.h"
+#include "stats.h"
+#include "the_deck.h"
+#include <memory>
+#include <optional>
+#include <string>
+
+using std::lock_guard;
+using std::make_shared;
+using std::min;
+using std::mutex;
+using std::shared_ptr;
+using std::span;
+using std::string;
+using std::vector;
+using The_Deck::detail::card_ordinal;
+using The_Deck::detail::LruCache;
+using The_Deck::detail::Stat;
+
+namespace The_Deck {
+namespace detail {
+    // One deck's keystream prefix, along with a generator that has
+    // produced exactly that much, ready to extend it.
+    struct CachedKeystream {
+        explicit CachedKeystream(const Deck& deck)
+            : generator { deck }
+        {
+        }
+
+        mutex extend_mutex;
+        vector<uint8_t> prefix;
+        KeystreamGenerator generator;
+    };
+}
+
+namespace {
+    using The_Deck::detail::CachedKeystream;
+
+    struct KeystreamCache {
+        mutex lookup_mutex;
+        LruCache<string, shared_ptr<CachedKeystream>> entries { 0 };
+        size_t max_prefix { 0 };
+    };
+
+    KeystreamCache& keystream_cache()
+    {
+        static KeystreamCache cache;
+        return cache;
+    }
+
+    // The cache is keyed on the deck's card order, one byte per card.
+    string deck_key(const Deck& deck)
+    {
+        string key(deck.size(), '\0');
+        for (size_t i = 0; i < deck.size(); i++)
+            key[i] = static_cast<char>(card_ordinal(deck.deck[i]));
+        return key;
+    }
+
+    // Finds the deck's entry, adding one if it isn't there, or returns
+    // nothing if the cache is off. The deck is only asked for once the
+    // cache is known to be on.
+    template <typename GetDeck>
+    shared_ptr<CachedKeystream> find_entry(const GetDeck& get_deck, size_t& max_prefix)
+    {
+        auto& cache = keystream_cache();
+        const lock_guard<mutex> lock(cache.lookup_mutex);
+        if (cache.entries.capacity() == 0)
+            return nullptr;
+        max_prefix = cache.max_prefix;
+        const auto deck = get_deck();
+        const auto key = deck_key(deck);
+        if (const auto found = cache.entries.find(key)) {
+            detail::count(Stat::KEYSTREAM_CACHE_HITS);
+            return *found;
+        }
+        detail::count(Stat::KEYSTREAM_CACHE_MISSES);
+        return *cache.entries.insert(key, make_shared<CachedKeystream>(deck));
+    }
+
+    // Extends the entry's prefix to at least `size` values. The caller
+    // holds its extend_mutex.
+    void extend(CachedKeystream& entry, const size_t size)
+    {
+        auto& prefix = entry.prefix;
+        if (prefix.size() < size) {
+            const auto old_size = prefix.size();
+            prefix.resize(size);
+            entry.generator.generate(span(prefix).subspan(old_size));
+        }
+    }
+}
+
+void set_keystream_cache_capacity(const size_t decks, const size_t max_prefix)
+{
+    auto& cache = keystream_cache();
+    const lock_guard<mutex> lock(cache.lookup_mutex);
+    cache.entries = LruCache<string, shared_ptr<CachedKeystream>>(decks);
+    cache.max_prefix = max_prefix;
+}
+
+size_t keystream_cache_capacity()
+{
+    auto& cache = keystream_cache();
+    const lock_guard<mutex> lock(cache.lookup_mutex);
+    return cache.entries.capacity();
+}
+
+void fill_keystream(const Deck& deck, const span<uint8_t> output)
+{
+    size_t max_prefix = 0;
+    const auto entry = find_entry([&] { return deck; }, max_prefix);
+    if (!entry) {
+        KeystreamGenerator(deck).generate(output);
+        return;
+    }
+
+    // Other threads can carry on looking up other decks while this one
+    // extends (or just reads) its prefix. Anything past the longest
+    // prefix we're willing to keep comes from a copy of the generator,
+    // which is sitting right at the end of it; that copy is taken under
+    // the lock and run after it's released, so threads encrypting long
+    // messages under the same deck don't queue up behind each other.
+    const auto cached = min(output.size(), max_prefix);
+    std::optional<KeystreamGenerator> tail;
+    {
+        const lock_guard<mutex> lock(entry->extend_mutex);
+        extend(*entry, cached);
+        std::copy_n(entry->prefix.begin(), cached, output.begin());
+        if (output.size() > cached)
+            tail.emplace(entry->generator);
+    }
+    if (tail)
+        tail->generate(output.subspan(cached));
+}
+
+namespace detail {
+    shared_ptr<CachedKeystream> find_cached_keystream(const KeystreamGenerator& start,
+        size_t& max_prefix)
+    {
+        return find_entry([&] { return start.deck(); }, max_prefix);
+    }
+
+    void read_cached_keystream(CachedKeystream& entry, const size_t from, const span<uint8_t> output)
+    {
+        const lock_guard<mutex> lock(entry.extend_mutex);
+        extend(entry, from + output.size());
+        std::copy_n(entry.prefix.begin() + static_cast<std::ptrdiff_t>(from), output.size(),
+            output.begin());
+    }
+
+    KeystreamGenerator cached_keystream_end(CachedKeystream& entry, const size_t max_prefix)
+    {
+        const lock_guard<mutex> lock(entry.extend_mutex);
+        extend(entry, max_prefix);
+        return entry.generator;
+    }
+}
+} // namespace The_Deck
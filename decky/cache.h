@@ -0,0 +1,32 @@
+#ifndef DECKY_CACHE_H
+#define DECKY_CACHE_H
+
+#include "the_deck.h"
+#include <memory>
+#include <span>
+
+/* Library-internal access to the keystream cache for callers that don't
+ * know up front how much keystream they'll want, such as the streaming
+ * interfaces. */
+
+namespace The_Deck::detail {
+/* A deck's entry in the keystream cache: its keystream prefix and a
+ * generator sitting at the end of it. */
+struct CachedKeystream;
+
+/* Looks up the entry for the deck `start` was made from, adding one if it
+ * isn't there, and sets `max_prefix` to how long its prefix may grow.
+ * Returns null if the cache is off. */
+std::shared_ptr<CachedKeystream> find_cached_keystream(const KeystreamGenerator& start,
+    size_t& max_prefix);
+
+/* Copies the keystream values from position `from` on into `output`,
+ * extending the entry's prefix to cover them. They must lie within
+ * max_prefix, and only they are copied. */
+void read_cached_keystream(CachedKeystream& entry, size_t from, std::span<uint8_t> output);
+
+/* Returns a generator whose next value is the one just past max_prefix,
+ * extending the entry's prefix that far first. */
+KeystreamGenerator cached_keystream_end(CachedKeystream& entry, size_t max_prefix);
+} // namespace The_Deck::detail
+#endif
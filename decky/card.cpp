@@ -1,3 +1,4 @@
+#include "ordinals.h"
 #include "the_deck.h"
 
 namespace The_Deck {
@@ -14,6 +15,10 @@ bool Card::operator<(
     if (RANK == Rank::JOKER_B && other.RANK != Rank::JOKER_A)
         return true;
 
+    // The jokers come before every ordinary card.
+    if (other.RANK == Rank::JOKER_A || other.RANK == Rank::JOKER_B)
+        return false;
+
     const auto suit = static_cast<uint32_t>(SUIT);
     const auto rank = static_cast<uint32_t>(RANK);
     const auto other_suit = static_cast<uint32_t>(other.SUIT);
@@ -35,4 +40,10 @@ int32_t Card::card_as_int() const
         ? 52
         : static_cast<int32_t>(SUIT) * 13 + static_cast<int32_t>(RANK);
 }
+PackedCard::PackedCard(const Card& card)
+    : packed { static_cast<uint8_t>(detail::card_ordinal(card)) }
+{
+    if (packed >= COUNT)
+        throw std::invalid_argument("PackedCard: not one of the standard fifty-four cards");
+}
 } // namespace The_Deck
@@ -0,0 +1,45 @@
+#ifndef DECKY_CPU_FEATURES_H
+#define DECKY_CPU_FEATURES_H
+
+/* Library-internal switches for the SIMD code paths. DECKY_SSE2 is set on
+ * x86-64, where SSE2 is always there. DECKY_AVX2 is set wherever an AVX2
+ * path can be built, even if the rest of the library isn't built for it;
+ * such code is marked DECKY_TARGET_AVX2 and only run if have_avx2() says
+ * the processor can take it. */
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define DECKY_SSE2 1
+// GCC and Clang can build an AVX2 path even when the rest of the library
+// isn't, and we check at runtime whether the processor can take it.
+#if defined(__AVX2__)
+#define DECKY_AVX2 1
+#define DECKY_TARGET_AVX2
+#elif defined(__GNUC__)
+#define DECKY_AVX2 1
+#define DECKY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define DECKY_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define DECKY_ALWAYS_INLINE __forceinline
+#else
+#define DECKY_ALWAYS_INLINE inline
+#endif
+
+namespace The_Deck::detail {
+#ifdef DECKY_AVX2
+inline bool have_avx2()
+{
+#if defined(__AVX2__)
+    return true;
+#else
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#endif
+}
+#endif
+} // namespace The_Deck::detail
+#endif
@@ -0,0 +1,51 @@
+#include "the_deck.h"
+#include "thread_pool.h"
+#include <utility>
+
+using std::array;
+using std::invalid_argument;
+using std::span;
+using std::vector;
+
+namespace The_Deck {
+namespace {
+    constexpr size_t SMALLEST_DECK = 3;
+
+    using Search = void (*)(span<const uint8_t>, uint64_t, span<CycleLength>);
+
+    template <size_t N>
+    void search_sized(const span<const uint8_t> decks, const uint64_t max_rounds,
+        const span<CycleLength> results)
+    {
+        detail::shared_pool()->parallel_for(results.size(), [&](const size_t i) {
+            array<uint8_t, N> ordinals;
+            std::copy_n(decks.begin() + i * N, N, ordinals.begin());
+            results[i] = find_cycle(SizedDeck<N>(ordinals), max_rounds);
+        });
+    }
+
+    // search_sized for every deck size, indexed by size less three, so
+    // that each size runs its own specialized code.
+    template <size_t... Sizes>
+    constexpr auto make_searches(std::index_sequence<Sizes...>)
+    {
+        return array<Search, sizeof...(Sizes)> { &search_sized<Sizes + SMALLEST_DECK>... };
+    }
+
+    constexpr auto searches = make_searches(
+        std::make_index_sequence<Deck::MAX_CARDS - SMALLEST_DECK + 1>());
+}
+
+vector<CycleLength> find_cycles(const size_t cards, const span<const uint8_t> decks,
+    const uint64_t max_rounds)
+{
+    if (cards < SMALLEST_DECK || cards > Deck::MAX_CARDS)
+        throw invalid_argument("find_cycles: a deck must have from 3 to 54 cards");
+    if (decks.size() % cards)
+        throw invalid_argument("find_cycles: the ordinals don't divide into whole decks");
+
+    vector<CycleLength> results(decks.size() / cards);
+    searches[cards - SMALLEST_DECK](decks, max_rounds, results);
+    return results;
+}
+} // namespace The_Deck
@@ -1,45 +1,212 @@
+#include "ordinals.h"
 #include "the_deck.h"
-#include <tuple>
+#include <bit>
 
-using std::get;
-using std::lock_guard;
+using std::invalid_argument;
 using std::logic_error;
 using std::mt19937;
-using std::mutex;
 using std::ostream;
 using std::out_of_range;
 using std::random_device;
 using std::swap;
-using std::tuple;
-using std::vector;
-using std::ranges::all_of;
-using std::ranges::copy;
 using std::ranges::find;
 using std::ranges::find_if;
-using std::views::zip;
 
 namespace The_Deck {
+static_assert(std::is_trivially_copyable_v<Deck>,
+    "Copying a Deck must stay a plain memcpy");
+
 const Card Deck::JOKER_A(Card::Suit::NONE, Card::Rank::JOKER_A);
 const Card Deck::JOKER_B(Card::Suit::NONE, Card::Rank::JOKER_B);
 
+namespace {
+    // Each thread seeds its own generator the first time it needs one, so
+    // loading the library doesn't touch the random device and shuffling
+    // doesn't take a lock. A seed sequence spreads a few words from the
+    // device across the whole of the generator's state.
+    mt19937& thread_generator()
+    {
+        thread_local mt19937 generator = [] {
+            random_device device;
+            std::array<random_device::result_type, 8> words;
+            std::ranges::generate(words, std::ref(device));
+            std::seed_seq seeds(words.begin(), words.end());
+            return mt19937(seeds);
+        }();
+        return generator;
+    }
+
+    // The Lehmer code is worked on as a little-endian number in 32-bit
+    // limbs, which has room to spare for 54! (about 2^238).
+    using Lehmer = std::array<uint32_t, 8>;
+
+    // value = value * radix + digit
+    void multiply_add(Lehmer& value, const uint32_t radix, uint32_t digit)
+    {
+        uint64_t carry = digit;
+        for (auto& limb : value) {
+            const auto product = static_cast<uint64_t>(limb) * radix + carry;
+            limb = static_cast<uint32_t>(product);
+            carry = product >> 32;
+        }
+    }
+
+    // value /= radix, returning the remainder
+    uint32_t divide(Lehmer& value, const uint32_t radix)
+    {
+        uint64_t remainder = 0;
+        for (auto limb = value.rbegin(); limb != value.rend(); ++limb) {
+            const auto dividend = (remainder << 32) | *limb;
+            *limb = static_cast<uint32_t>(dividend / radix);
+            remainder = dividend % radix;
+        }
+        return static_cast<uint32_t>(remainder);
+    }
+
+    // Mixes 64 bits at a time into the hash, in the manner of xxHash.
+    constexpr uint64_t HASH_PRIME_1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t HASH_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+
+    uint64_t hash_round(const uint64_t hash, const uint64_t word)
+    {
+        return std::rotl(hash ^ (word * HASH_PRIME_2), 31) * HASH_PRIME_1;
+    }
+
+    uint64_t hash_finish(uint64_t hash)
+    {
+        hash ^= hash >> 33;
+        hash *= HASH_PRIME_2;
+        hash ^= hash >> 29;
+        hash *= 0x165667B19E3779F9ULL;
+        return hash ^ (hash >> 32);
+    }
+}
+
+Deck::Deck(const std::span<const PackedCard> packed_deck)
+{
+    if (packed_deck.size() > MAX_CARDS)
+        throw std::length_error("Deck: too many cards");
+    for (const auto card : packed_deck)
+        deck.push_back(card);
+    reindex();
+}
+
+FixedVector<PackedCard, Deck::MAX_CARDS> Deck::packed() const
+{
+    FixedVector<PackedCard, MAX_CARDS> cards;
+    for (const auto& card : deck)
+        cards.push_back(PackedCard(card));
+    return cards;
+}
+
+Deck::Deck(const DeckCode& code)
+{
+    if (code.cards > MAX_CARDS)
+        throw invalid_argument("Deck: not a deck code");
+    Lehmer value {};
+    for (size_t byte = 0; byte < DeckCode::SIZE; byte++)
+        value[byte / 4] |= static_cast<uint32_t>(code.lehmer[byte]) << (8 * (byte % 4));
+
+    // The digits come back out last first; each is the card's rank among
+    // the cards still unplaced when it was placed.
+    std::array<uint8_t, MAX_CARDS> digits {};
+    for (size_t i = code.cards; i-- > 0;)
+        digits[i] = static_cast<uint8_t>(divide(value, static_cast<uint32_t>(MAX_CARDS - i)));
+    if (std::ranges::any_of(value, [](const uint32_t limb) { return limb != 0; }))
+        throw invalid_argument("Deck: not a deck code");
+
+    uint64_t unplaced = (uint64_t { 1 } << MAX_CARDS) - 1;
+    for (size_t i = 0; i < code.cards; i++) {
+        auto rest = unplaced;
+        for (auto skip = digits[i]; skip > 0; skip--)
+            rest &= rest - 1;
+        const auto ordinal = std::countr_zero(rest);
+        unplaced &= ~(uint64_t { 1 } << ordinal);
+        deck.push_back(detail::ordinal_card(static_cast<size_t>(ordinal)));
+    }
+    reindex();
+}
+
+DeckCode Deck::code() const
+{
+    DeckCode code;
+    code.cards = static_cast<uint8_t>(deck.size());
+    Lehmer value {};
+    uint64_t placed = 0;
+    for (size_t i = 0; i < deck.size(); i++) {
+        const auto ordinal = detail::card_ordinal(deck[i]);
+        const auto bit = uint64_t { 1 } << ordinal;
+        if (ordinal >= MAX_CARDS || (placed & bit))
+            throw invalid_argument("Deck: only a deck of distinct standard cards has a code");
+        const auto digit = std::popcount(~placed & (bit - 1));
+        placed |= bit;
+        multiply_add(value, static_cast<uint32_t>(MAX_CARDS - i), static_cast<uint32_t>(digit));
+    }
+    for (size_t byte = 0; byte < DeckCode::SIZE; byte++)
+        code.lehmer[byte] = static_cast<uint8_t>(value[byte / 4] >> (8 * (byte % 4)));
+    return code;
+}
+
+uint64_t Deck::hash() const noexcept
+{
+    // The cards' ordinals, eight to a word, then the length.
+    uint64_t hash = HASH_PRIME_1 + deck.size();
+    uint64_t word = 0;
+    for (size_t i = 0; i < deck.size(); i++) {
+        word |= static_cast<uint64_t>(detail::card_ordinal(deck[i])) << (8 * (i % 8));
+        if (i % 8 == 7) {
+            hash = hash_round(hash, word);
+            word = 0;
+        }
+    }
+    if (deck.size() % 8)
+        hash = hash_round(hash, word);
+    return hash_finish(hash ^ deck.size());
+}
+
+void Deck::reindex(const size_t first, const size_t last)
+{
+    for (size_t i = first; i < last; i++) {
+        const auto slot = detail::card_ordinal(deck[i]);
+        if (slot < MAX_CARDS)
+            positions[slot] = static_cast<uint8_t>(i);
+    }
+}
+
+size_t Deck::locate(const Card& card)
+{
+    const auto slot = detail::card_ordinal(card);
+    if (slot < MAX_CARDS) {
+        if (positions[slot] < deck.size() && deck[positions[slot]] == card)
+            return positions[slot];
+        // Someone has been rearranging the deck behind our back.
+        reindex();
+        if (positions[slot] < deck.size() && deck[positions[slot]] == card)
+            return positions[slot];
+    }
+    return static_cast<size_t>(find(deck, card) - deck.begin());
+}
+
 Card& Deck::operator[](size_t index) { return deck.at(index); }
 
 const Card& Deck::operator[](size_t index) const { return deck.at(index); }
 
 bool Deck::operator==(const Deck& other) const
 {
-    return all_of(zip(deck, other.deck),
-        [](const auto& item) { return get<0>(item) == get<1>(item); });
+    // Comparing the sizes too keeps decks that merely start the same, like
+    // a deck with jokers and one without, from counting as equal, which
+    // code() and hash() rely on.
+    return deck == other.deck;
 }
 
-void Deck::shuffle()
+void Deck::shuffle() { shuffle(thread_generator()); }
+
+void Deck::sort()
 {
-    const lock_guard<mutex> lock(gen_mutex);
-    std::ranges::shuffle(deck, gen);
+    std::sort(deck.begin(), deck.end());
+    reindex();
 }
 
-void Deck::sort() { std::sort(deck.begin(), deck.end()); }
-
 Card Deck::deal(const long position)
 {
     if (position < 0 || position >= deck.size())
@@ -47,6 +214,7 @@ Card Deck::deal(const long position)
     // Already bounds-checked in previous line.  No risk exposure here.
     Card card(deck[position]);
     deck.erase(deck.begin() + position);
+    reindex(position, deck.size());
     return card;
 }
 
@@ -58,58 +226,91 @@ void Deck::insert(const Card& card, const long position)
         deck.push_back(card);
     else
         deck.insert(deck.cbegin() + position, card);
+    reindex(position, deck.size());
 }
 
 void Deck::triple_cut()
 {
-    auto first_joker = find_if(deck, [](const auto& card) {
-        return (card.RANK == Card::Rank::JOKER_A || card.RANK == Card::Rank::JOKER_B);
-    });
-    if (first_joker == deck.cend()) // Test if there are not enough jokers in the deck
-        throw logic_error(
-            "No jokers found while trying to perform a triple cut. We need two.");
-
-    auto second_joker = find_if(first_joker + 1, deck.end(), [](const auto& card) {
-        return (card.RANK == Card::Rank::JOKER_A || card.RANK == Card::Rank::JOKER_B);
-    });
-    if (second_joker == deck.cend())
-        throw logic_error("Only one joker found while trying to perform a triple "
-                          "cut. We need two.");
-
-    vector<Card> to_first_joker(deck.begin(), first_joker);
-    vector<Card> after_second_joker(second_joker + 1, deck.end());
+    const auto joker_a = locate(JOKER_A);
+    const auto joker_b = locate(JOKER_B);
+    auto first_joker = deck.begin() + std::min(joker_a, joker_b);
+    auto second_joker = deck.begin() + std::max(joker_a, joker_b);
 
-    // Erase the second half first to avoid making the first iterator invalid
-    deck.erase(second_joker + 1, deck.end());
-    deck.erase(deck.begin(), first_joker);
+    // Not the standard pair of jokers, so go looking for anything that
+    // ranks as one.
+    if (second_joker == deck.end()) {
+        first_joker = find_if(deck, [](const auto& card) {
+            return (card.RANK == Card::Rank::JOKER_A || card.RANK == Card::Rank::JOKER_B);
+        });
+        if (first_joker == deck.cend()) // Test if there are not enough jokers in the deck
+            throw logic_error(
+                "No jokers found while trying to perform a triple cut. We need two.");
 
-    copy(deck, back_inserter(after_second_joker));
-    copy(to_first_joker.cbegin(), to_first_joker.cend(),
-        back_inserter(after_second_joker));
+        second_joker = find_if(first_joker + 1, deck.end(), [](const auto& card) {
+            return (card.RANK == Card::Rank::JOKER_A || card.RANK == Card::Rank::JOKER_B);
+        });
+        if (second_joker == deck.cend())
+            throw logic_error("Only one joker found while trying to perform a triple "
+                              "cut. We need two.");
+    }
 
-    deck = after_second_joker;
+    // The deck is [top][jokers and everything between][bottom], and we
+    // want [bottom][jokers and everything between][top]. Rotating the top
+    // block to the end gives [middle][bottom][top], and rotating the bottom
+    // block past the middle finishes the job -- all in place.
+    const auto middle_size = second_joker - first_joker + 1;
+    const auto bottom_size = deck.end() - second_joker - 1;
+    std::rotate(deck.begin(), first_joker, deck.end());
+    std::rotate(deck.begin(), deck.begin() + middle_size,
+        deck.begin() + middle_size + bottom_size);
+    reindex();
 }
 
 void Deck::bury_1_with_wraparound(const Card& card)
 {
-    auto card_location { find(deck, card) };
+    const auto card_location { locate(card) };
 
-    if (card_location == deck.end())
+    if (card_location == deck.size())
         throw logic_error("Card not found");
+    if (deck.size() < 2)
+        return;
 
-    if (card_location == (deck.end() - 1)) {
-        auto last_card = *(deck.end() - 1);
-        deck.pop_back();
-        deck.insert(deck.begin(), last_card);
-        card_location = deck.begin();
+    // The bottom card wraps around to sit just beneath the top card.
+    if (card_location == deck.size() - 1) {
+        std::rotate(deck.begin() + 1, deck.end() - 1, deck.end());
+        reindex(1, deck.size());
+        return;
     }
-    swap(*card_location, *(card_location + 1));
+    swap(deck[card_location], deck[card_location + 1]);
+    reindex(card_location, card_location + 2);
 }
 
 void Deck::bury_with_wraparound(const Card& card, const size_t slots_down)
 {
-    for (size_t i = 0; i < slots_down; i++)
-        bury_1_with_wraparound(card);
+    if (slots_down == 0)
+        return;
+
+    const auto from { locate(card) };
+
+    if (from == deck.size())
+        throw logic_error("Card not found");
+    if (deck.size() < 2)
+        return;
+
+    // Burying one slot at a time walks the card down the deck until it
+    // hits the bottom, at which point it wraps around to position 1.
+    // Past the first move it's cycling through positions 1..n-1, so we
+    // can work out where it lands in one go.
+    const auto cycle = deck.size() - 1;
+    const auto to = 1 + (from + (slots_down - 1) % cycle) % cycle;
+
+    if (to > from)
+        std::rotate(deck.begin() + from, deck.begin() + from + 1,
+            deck.begin() + to + 1);
+    else if (to < from)
+        std::rotate(deck.begin() + to, deck.begin() + from,
+            deck.begin() + from + 1);
+    reindex(std::min(from, to), std::max(from, to) + 1);
 }
 
 void Deck::bury_joker_a() { bury_1_with_wraparound(JOKER_A); }
@@ -119,14 +320,14 @@ void Deck::bury_joker_b() { bury_with_wraparound(JOKER_B, 2); }
 void Deck::count_cut()
 {
     const Card& last_card = *(deck.end() - 1);
-    auto index = last_card.card_as_int() + 1;
+    const auto index = static_cast<size_t>(last_card.card_as_int()) + 1;
 
-    if (index == deck.size())
+    if (index >= deck.size())
         return;
 
-    vector temp_cards(deck.begin(), deck.begin() + index);
-    deck.erase(deck.begin(), deck.begin() + index);
-    deck.insert(deck.end() - 1, temp_cards.begin(), temp_cards.end());
+    // Move the top cards to just above the bottom card.
+    std::rotate(deck.begin(), deck.begin() + index, deck.end() - 1);
+    reindex();
 }
 
 uint32_t Deck::get_keystream_value() const
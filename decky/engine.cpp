@@ -0,0 +1,314 @@
+#include "ordinals.h"
+#include "stats.h"
+#include "the_deck.h"
+#include <cstring>
+
+using std::array;
+using std::invalid_argument;
+using std::logic_error;
+using std::max;
+using std::min;
+using std::out_of_range;
+using std::span;
+using The_Deck::detail::card_ordinal;
+using The_Deck::detail::JOKER_A_ORDINAL;
+using The_Deck::detail::JOKER_B_ORDINAL;
+using The_Deck::detail::ordinal_card;
+using The_Deck::detail::ordinal_value;
+using The_Deck::detail::Stat;
+
+namespace The_Deck {
+namespace {
+    // Burying a card walks it down the deck one slot at a time, wrapping
+    // around from the bottom to just beneath the top card. Once it's
+    // moved at all it's cycling through positions 1..n-1, which gives us
+    // its final position directly.
+    constexpr size_t buried(const size_t position, const size_t slots,
+        const size_t n)
+    {
+        auto offset = position + slots - 1;
+        while (offset >= n - 1)
+            offset -= n - 1;
+        return 1 + offset;
+    }
+
+    // Where a card at `position` ends up when the card at `from` is taken
+    // out and reinserted at `to`.
+    constexpr size_t displaced(size_t position, const size_t from,
+        const size_t to)
+    {
+        position -= (position > from);
+        position += (position >= to);
+        return position;
+    }
+
+    // Copies `length` bytes as one fixed-size block, which the compiler
+    // turns into a couple of vector moves. Whatever spills past the end is
+    // either overwritten by the next copy or lands in a buffer's slack.
+    inline uint8_t* overcopy(uint8_t* out, const uint8_t* in, const size_t length)
+    {
+        std::memcpy(out, in, KeystreamEngine::OVERCOPY);
+        return out + length;
+    }
+
+    // One round of Solitaire from the n-card deck of ordinals at `in` to
+    // the buffer at `out`, both with OVERCOPY bytes of slack, updating
+    // where the jokers are. Returns the keystream value, or 53 for a
+    // joker.
+    uint8_t step_ordinals(const uint8_t* in, uint8_t* out, const size_t n,
+        uint8_t& joker_a, uint8_t& joker_b)
+    {
+        // Bury joker A one slot, then joker B two slots.
+        const auto a1 = buried(joker_a, 1, n);
+        const auto b1 = displaced(joker_b, joker_a, a1);
+        const auto b2 = buried(b1, 2, n);
+        const auto a2 = displaced(a1, b1, b2);
+
+        // Neither bury nor either cut changes the order of the non-joker
+        // cards relative to each other, so pull them out of the deck first.
+        const size_t low = min(joker_a, joker_b);
+        const size_t high = max(joker_a, joker_b);
+        array<uint8_t, Deck::MAX_CARDS + KeystreamEngine::OVERCOPY> others;
+        auto* o = overcopy(others.data(), in, low);
+        o = overcopy(o, in + low + 1, high - low - 1);
+        overcopy(o, in + high + 1, n - high - 1);
+
+        // Triple cut: [top][J1 ... J2][bottom] becomes [bottom][J1 ... J2][top],
+        // where top and bottom are runs of the non-joker cards. We lay the
+        // result out twice over, less its last card the first time around, so
+        // that the count cut becomes a single block copy out of the middle.
+        const size_t top = min(a2, b2);
+        const size_t bottom = max(a2, b2) - 1;
+        const uint8_t first_joker = a2 < b2 ? JOKER_A_ORDINAL : JOKER_B_ORDINAL;
+        const uint8_t second_joker = a2 < b2 ? JOKER_B_ORDINAL : JOKER_A_ORDINAL;
+        array<uint8_t, 2 * Deck::MAX_CARDS + KeystreamEngine::OVERCOPY> doubled;
+        auto* d = doubled.data();
+        for (size_t pass = 0; pass < 2; pass++) {
+            d = overcopy(d, others.data() + bottom, n - 2 - bottom);
+            *d++ = first_joker;
+            d = overcopy(d, others.data() + top, bottom - top);
+            *d++ = second_joker;
+            d = overcopy(d, others.data(), top);
+            d -= (pass == 0);
+        }
+
+        // Count cut, by the value of whatever the triple cut left on the
+        // bottom. A cut of n - 1 or more cards leaves the deck as it is.
+        const auto last = doubled[2 * n - 2];
+        const size_t cut = min<size_t>(ordinal_value(last), n - 1);
+        overcopy(out, doubled.data() + cut, n - 1);
+        out[n - 1] = last;
+
+        const auto moved = [&](const size_t position) {
+            return position >= cut ? position - cut : position + n - 1 - cut;
+        };
+        const auto first_position = moved(n - 1 - (bottom + 1));
+        const auto second_position = last == second_joker ? n - 1 : moved(n - 1 - top);
+        joker_a = static_cast<uint8_t>(first_joker == JOKER_A_ORDINAL ? first_position : second_position);
+        joker_b = static_cast<uint8_t>(first_joker == JOKER_B_ORDINAL ? first_position : second_position);
+
+        const size_t index = ordinal_value(out[0]);
+        if (index >= n)
+            throw out_of_range("KeystreamEngine: the top card counts past the bottom of the deck");
+        return ordinal_value(out[index]);
+    }
+
+    uint8_t card_value(const Card& card)
+    {
+        const auto ordinal = card_ordinal(card);
+        if (ordinal >= Deck::MAX_CARDS)
+            throw invalid_argument("get_raw_keystream_value: the deck holds a nonstandard card");
+        return ordinal_value(static_cast<uint8_t>(ordinal));
+    }
+
+    // A Card, moved about as the eight bytes it is.
+    using CardBits = uint64_t;
+    static_assert(sizeof(Card) == sizeof(CardBits) && std::is_trivially_copyable_v<Card>);
+
+    inline CardBits* copy_cards(CardBits* out, const void* in, const size_t count)
+    {
+        std::memcpy(out, in, count * sizeof(CardBits));
+        return out + count;
+    }
+
+    // step_ordinals, made on a deck's own cards: the same joker arithmetic
+    // and the same block moves, less the overcopying, which would move
+    // eight times as much here.
+    uint8_t step_cards(Card* cards, const size_t n, size_t& joker_a, size_t& joker_b)
+    {
+        const auto a1 = buried(joker_a, 1, n);
+        const auto b1 = displaced(joker_b, joker_a, a1);
+        const auto b2 = buried(b1, 2, n);
+        const auto a2 = displaced(a1, b1, b2);
+
+        CardBits a;
+        CardBits b;
+        std::memcpy(&a, cards + joker_a, sizeof a);
+        std::memcpy(&b, cards + joker_b, sizeof b);
+        const size_t low = min(joker_a, joker_b);
+        const size_t high = max(joker_a, joker_b);
+        array<CardBits, Deck::MAX_CARDS> others;
+        auto* o = copy_cards(others.data(), cards, low);
+        o = copy_cards(o, cards + low + 1, high - low - 1);
+        copy_cards(o, cards + high + 1, n - high - 1);
+
+        const size_t top = min(a2, b2);
+        const size_t bottom = max(a2, b2) - 1;
+        array<CardBits, Deck::MAX_CARDS> tripled;
+        auto* t = copy_cards(tripled.data(), others.data() + bottom, n - 2 - bottom);
+        *t++ = a2 < b2 ? a : b;
+        t = copy_cards(t, others.data() + top, bottom - top);
+        *t++ = a2 < b2 ? b : a;
+        copy_cards(t, others.data(), top);
+
+        std::memcpy(static_cast<void*>(cards + n - 1), &tripled[n - 1], sizeof(CardBits));
+        const size_t cut = min<size_t>(card_value(cards[n - 1]), n - 1);
+        std::memcpy(static_cast<void*>(cards), tripled.data() + cut, (n - 1 - cut) * sizeof(CardBits));
+        std::memcpy(static_cast<void*>(cards + n - 1 - cut), tripled.data(), cut * sizeof(CardBits));
+
+        const auto moved = [&](const size_t position) {
+            return position >= cut ? position - cut : position + n - 1 - cut;
+        };
+        const auto first_position = moved(n - 2 - bottom);
+        const auto second_position = top == 0 ? n - 1 : moved(n - 1 - top);
+        joker_a = a2 < b2 ? first_position : second_position;
+        joker_b = a2 < b2 ? second_position : first_position;
+
+        const size_t index = card_value(cards[0]);
+        if (index >= n)
+            throw out_of_range("get_raw_keystream_value: the top card counts past the bottom of the deck");
+        return card_value(cards[index]);
+    }
+}
+
+KeystreamEngine::KeystreamEngine(const Deck& deck)
+    : count { static_cast<uint8_t>(deck.size()) }
+{
+    bool seen_a = false;
+    bool seen_b = false;
+    for (size_t i = 0; i < deck.size(); i++) {
+        const auto ordinal = card_ordinal(deck.deck[i]);
+        if (ordinal >= Deck::MAX_CARDS)
+            throw invalid_argument("KeystreamEngine: the deck holds a nonstandard card");
+        if (ordinal == JOKER_A_ORDINAL) {
+            if (seen_a)
+                throw logic_error("KeystreamEngine: the deck holds two A jokers");
+            seen_a = true;
+            joker_a = static_cast<uint8_t>(i);
+        } else if (ordinal == JOKER_B_ORDINAL) {
+            if (seen_b)
+                throw logic_error("KeystreamEngine: the deck holds two B jokers");
+            seen_b = true;
+            joker_b = static_cast<uint8_t>(i);
+        }
+        buffers[0][i] = static_cast<uint8_t>(ordinal);
+    }
+    if (!seen_a || !seen_b)
+        throw logic_error("KeystreamEngine: Solitaire needs both jokers");
+    detail::count(Stat::DECK_COPIES);
+}
+
+uint8_t KeystreamEngine::step()
+{
+    const auto ks_val = step_ordinals(buffers[current].data(), buffers[current ^ 1].data(),
+        count, joker_a, joker_b);
+    current ^= 1;
+    return ks_val;
+}
+
+void KeystreamEngine::count_cut(const size_t cards)
+{
+    const size_t n = count;
+    const auto cut = min(cards, n - 1);
+    const auto* in = buffers[current].data();
+    auto* out = buffers[current ^ 1].data();
+    overcopy(overcopy(out, in + cut, n - 1 - cut), in, cut);
+    out[n - 1] = in[n - 1];
+
+    const auto moved = [&](const size_t position) {
+        if (position == n - 1)
+            return position;
+        return position >= cut ? position - cut : position + n - 1 - cut;
+    };
+    joker_a = static_cast<uint8_t>(moved(joker_a));
+    joker_b = static_cast<uint8_t>(moved(joker_b));
+    current ^= 1;
+}
+
+uint8_t KeystreamEngine::next_raw()
+{
+    uint64_t steps = 1;
+    auto ks_val = step();
+    for (; ks_val == 53; steps++)
+        ks_val = step();
+    detail::count(Stat::KEYSTREAM_STEPS, steps);
+    detail::count(Stat::JOKER_REJECTIONS, steps - 1);
+    return ks_val;
+}
+
+uint8_t KeystreamEngine::next()
+{
+    const auto ks_val = next_raw();
+    return ks_val > 26 ? ks_val - 26 : ks_val;
+}
+
+Deck KeystreamEngine::deck() const
+{
+    detail::count(Stat::DECK_COPIES);
+    FixedVector<Card, Deck::MAX_CARDS> cards;
+    for (size_t i = 0; i < count; i++)
+        cards.push_back(ordinal_card(buffers[current][i]));
+    return Deck(span<const Card>(cards.data(), cards.size()));
+}
+
+KeystreamGenerator::KeystreamGenerator(const Deck& deck)
+    : engine { deck }
+{
+}
+
+void KeystreamGenerator::generate_raw(const span<uint8_t> output)
+{
+    for (auto& value : output)
+        value = engine.next_raw();
+}
+
+void KeystreamGenerator::generate(const span<uint8_t> output)
+{
+    for (auto& value : output) {
+        const auto ks_val = engine.next_raw();
+        value = ks_val - 26 * (ks_val > 26);
+    }
+}
+
+Deck KeystreamGenerator::deck() const { return engine.deck(); }
+
+uint8_t get_raw_keystream_value(Deck& deck)
+{
+    // A KeystreamEngine would have to be built from the deck and a Deck
+    // built back out of it for every value, which costs far more than the
+    // step itself, so the deck is stepped where it lies. The jokers come
+    // from its position index, which is told where they end up; the
+    // other cards' entries are left to go stale and be rebuilt the next
+    // time one is looked up.
+    const size_t n = deck.size();
+    auto joker_a = deck.locate(Deck::JOKER_A);
+    auto joker_b = deck.locate(Deck::JOKER_B);
+    if (joker_a == n || joker_b == n) {
+        // Let the engine say what's wrong with the deck.
+        KeystreamEngine engine(deck);
+        const auto ks_val = engine.next_raw();
+        deck = engine.deck();
+        return ks_val;
+    }
+
+    uint64_t steps = 1;
+    auto ks_val = step_cards(deck.deck.data(), n, joker_a, joker_b);
+    for (; ks_val == 53; steps++)
+        ks_val = step_cards(deck.deck.data(), n, joker_a, joker_b);
+    deck.positions[JOKER_A_ORDINAL] = static_cast<uint8_t>(joker_a);
+    deck.positions[JOKER_B_ORDINAL] = static_cast<uint8_t>(joker_b);
+    detail::count(Stat::KEYSTREAM_STEPS, steps);
+    detail::count(Stat::JOKER_REJECTIONS, steps - 1);
+    return ks_val;
+}
+} // namespace The_Deck
@@ -0,0 +1,70 @@
+#include "the_deck.h"
+#include <cstring>
+
+using std::length_error;
+using std::span;
+
+namespace The_Deck {
+namespace {
+    constexpr size_t GROUP = 5;
+    constexpr size_t LINE = 40;
+
+    char separator(const uint64_t position)
+    {
+        return position % LINE == 0 ? '\n' : ' ';
+    }
+
+    // A whole line: eight groups of five with a space between each.
+    char* write_line(char* out, const uint8_t* in)
+    {
+        std::memcpy(out, in, GROUP);
+        out += GROUP;
+        for (size_t group = 1; group < LINE / GROUP; group++) {
+            *out++ = ' ';
+            std::memcpy(out, in + group * GROUP, GROUP);
+            out += GROUP;
+        }
+        return out;
+    }
+}
+
+size_t format_groups(const span<const uint8_t> letters, uint64_t position,
+    const span<char> output)
+{
+    if (output.size() < letters.size() + letters.size() / GROUP + 1)
+        throw length_error("format_groups: the output buffer is too small");
+
+    const auto* in = letters.data();
+    auto* out = output.data();
+    auto left = letters.size();
+
+    // Finish off the group the previous piece left open.
+    for (; left && position % GROUP; left--, position++)
+        *out++ = static_cast<char>(*in++);
+
+    while (left >= GROUP) {
+        if (position)
+            *out++ = separator(position);
+        if (position % LINE == 0 && left >= LINE) {
+            out = write_line(out, in);
+            in += LINE;
+            left -= LINE;
+            position += LINE;
+            continue;
+        }
+        std::memcpy(out, in, GROUP);
+        out += GROUP;
+        in += GROUP;
+        left -= GROUP;
+        position += GROUP;
+    }
+
+    if (left) {
+        if (position)
+            *out++ = separator(position);
+        std::memcpy(out, in, left);
+        out += left;
+    }
+    return static_cast<size_t>(out - output.data());
+}
+} // namespace The_Deck
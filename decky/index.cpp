@@ -0,0 +1,167 @@
+#include "ordinals.h"
+#include "the_deck.h"
+#include "thread_pool.h"
+#include <bitset>
+#include <optional>
+#include <string>
+
+using std::array;
+using std::invalid_argument;
+using std::min;
+using std::optional;
+using std::span;
+using std::string;
+using std::vector;
+using The_Deck::detail::card_ordinal;
+using The_Deck::detail::ordinal_card;
+
+namespace The_Deck {
+namespace {
+    // The serialized index: a magic number, a format version, the number
+    // of cards in the deck and the interval as a little-endian 32-bit
+    // number, and then the checkpoints.
+    constexpr array<uint8_t, 4> INDEX_MAGIC { 'D', 'K', 'I', 'X' };
+    constexpr uint8_t INDEX_VERSION = 1;
+    constexpr size_t INDEX_HEADER = 10;
+
+    // Steps the generator past `count` keystream values.
+    void skip(KeystreamGenerator& generator, uint64_t count)
+    {
+        array<uint8_t, 256> discard;
+        while (count > 0) {
+            const auto size = static_cast<size_t>(min<uint64_t>(count, discard.size()));
+            generator.generate_raw(span(discard).first(size));
+            count -= size;
+        }
+    }
+}
+
+KeystreamIndex::KeystreamIndex(const size_t interval, const size_t cards)
+    : every { interval }
+    , cards { cards }
+{
+    if (interval == 0)
+        throw invalid_argument("KeystreamIndex: the interval must be at least one letter");
+    // The serialized form has room for a 32-bit interval and no more.
+    if (interval > UINT32_MAX)
+        throw invalid_argument("KeystreamIndex: the interval can't be more than 2^32 - 1 letters");
+}
+
+KeystreamIndex::KeystreamIndex(const Deck& deck, const size_t interval)
+    : KeystreamIndex(interval, deck.size())
+{
+    // Let the generator vet the deck before we keep it.
+    KeystreamGenerator { deck };
+    append(deck);
+}
+
+void KeystreamIndex::append(const Deck& deck)
+{
+    for (size_t i = 0; i < deck.size(); i++)
+        states.push_back(static_cast<uint8_t>(card_ordinal(deck.deck[i])));
+}
+
+void KeystreamIndex::extend(const uint64_t letters)
+{
+    if (this->letters() >= letters)
+        return;
+    auto generator = seek((checkpoints() - 1) * every);
+    while (this->letters() < letters) {
+        skip(generator, every);
+        append(generator.deck());
+    }
+}
+
+KeystreamGenerator KeystreamIndex::seek(const uint64_t position) const
+{
+    const auto checkpoint = min<uint64_t>(position / every, checkpoints() - 1);
+    const auto* state = states.data() + checkpoint * cards;
+    FixedVector<Card, Deck::MAX_CARDS> deck;
+    for (size_t i = 0; i < cards; i++)
+        deck.push_back(ordinal_card(state[i]));
+
+    KeystreamGenerator generator(Deck(span<const Card>(deck.data(), deck.size())));
+    skip(generator, position - checkpoint * every);
+    return generator;
+}
+
+vector<uint8_t> KeystreamIndex::serialize() const
+{
+    vector<uint8_t> data(INDEX_MAGIC.begin(), INDEX_MAGIC.end());
+    data.push_back(INDEX_VERSION);
+    data.push_back(static_cast<uint8_t>(cards));
+    for (size_t byte = 0; byte < 4; byte++)
+        data.push_back(static_cast<uint8_t>(every >> (8 * byte)));
+    data.insert(data.end(), states.begin(), states.end());
+    return data;
+}
+
+KeystreamIndex KeystreamIndex::deserialize(const span<const uint8_t> data)
+{
+    if (data.size() < INDEX_HEADER
+        || !std::equal(INDEX_MAGIC.begin(), INDEX_MAGIC.end(), data.begin())
+        || data[4] != INDEX_VERSION)
+        throw invalid_argument("KeystreamIndex: not a keystream index");
+
+    const size_t cards = data[5];
+    size_t interval = 0;
+    for (size_t byte = 0; byte < 4; byte++)
+        interval |= static_cast<size_t>(data[6 + byte]) << (8 * byte);
+    const auto body = data.subspan(INDEX_HEADER);
+    if (cards == 0 || cards > Deck::MAX_CARDS || interval == 0
+        || body.empty() || body.size() % cards)
+        throw invalid_argument("KeystreamIndex: the index is truncated or corrupt");
+
+    // Every checkpoint has to be an arrangement of distinct cards; seek
+    // leaves it to the generator to check for the jokers.
+    for (size_t first = 0; first < body.size(); first += cards) {
+        std::bitset<Deck::MAX_CARDS> seen;
+        for (const auto ordinal : body.subspan(first, cards)) {
+            if (ordinal >= Deck::MAX_CARDS || seen[ordinal])
+                throw invalid_argument("KeystreamIndex: the index is truncated or corrupt");
+            seen[ordinal] = true;
+        }
+    }
+
+    KeystreamIndex index(interval, cards);
+    index.states.assign(body.begin(), body.end());
+    return index;
+}
+
+string crypt_indexed(const span<const char> input, const KeystreamIndex& index,
+    const Opmode mode)
+{
+    vector<uint8_t> values(input.size() + 4);
+    auto letters = normalize_letters(input, values);
+    if (letters == 0)
+        return {};
+    while (letters % 5)
+        values[letters++] = 'X' - 'A' + 1;
+
+    optional<KeystreamIndex> extended;
+    if (index.letters() < letters) {
+        extended = index;
+        extended->extend(letters);
+    }
+    const auto& covering = extended ? *extended : index;
+    const auto every = covering.interval();
+    const auto segments = (letters + every - 1) / every;
+
+    // Letter i lands at i + i / 5 in the output, with the space or newline
+    // before its group just ahead of it, so every segment can format its
+    // own stretch of the output independently.
+    string output(letters + letters / 5 + 1, '\0');
+    detail::shared_pool()->parallel_for(segments, [&](const size_t segment) {
+        const auto first = segment * every;
+        const auto text = span(values).subspan(first, min(every, letters - first));
+        thread_local vector<uint8_t> key;
+        key.resize(text.size());
+        covering.seek(first).generate(key);
+        combine_keystream(text, key, text, mode);
+        const auto start = first + first / 5 - (first % 5 == 0 && first > 0);
+        format_groups(text, first, span(output).subspan(start));
+    });
+    output.resize(letters + (letters - 1) / 5);
+    return output;
+}
+} // namespace The_Deck
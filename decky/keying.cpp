@@ -0,0 +1,132 @@
+#include "lru_cache.h"
+#include "the_deck.h"
+#include <array>
+#include <bit>
+#include <random>
+
+using std::array;
+using std::lock_guard;
+using std::mutex;
+using std::span;
+using std::vector;
+using The_Deck::detail::LruCache;
+
+namespace The_Deck {
+namespace {
+    // The cache is keyed on a 128-bit SipHash-2-4 digest of the
+    // passphrase's letters, under a secret drawn afresh for each process,
+    // so no passphrase sits in it in the clear. At 128 bits, two
+    // passphrases sharing a digest isn't a practical worry.
+    using Digest = array<uint64_t, 2>;
+
+    struct DigestHash {
+        size_t operator()(const Digest& digest) const { return static_cast<size_t>(digest[0]); }
+    };
+
+    void sip_round(array<uint64_t, 4>& v)
+    {
+        v[0] += v[1];
+        v[1] = std::rotl(v[1], 13) ^ v[0];
+        v[0] = std::rotl(v[0], 32);
+        v[2] += v[3];
+        v[3] = std::rotl(v[3], 16) ^ v[2];
+        v[0] += v[3];
+        v[3] = std::rotl(v[3], 21) ^ v[0];
+        v[2] += v[1];
+        v[1] = std::rotl(v[1], 17) ^ v[2];
+        v[2] = std::rotl(v[2], 32);
+    }
+
+    Digest siphash(const array<uint64_t, 2>& secret, const span<const uint8_t> data)
+    {
+        array<uint64_t, 4> v { secret[0] ^ 0x736f6d6570736575ULL, secret[1] ^ 0x646f72616e646f6dULL ^ 0xee,
+            secret[0] ^ 0x6c7967656e657261ULL, secret[1] ^ 0x7465646279746573ULL };
+        const auto absorb = [&](const uint64_t word) {
+            v[3] ^= word;
+            sip_round(v);
+            sip_round(v);
+            v[0] ^= word;
+        };
+
+        uint64_t word = 0;
+        for (size_t i = 0; i < data.size(); i++) {
+            word |= static_cast<uint64_t>(data[i]) << (8 * (i % 8));
+            if (i % 8 == 7) {
+                absorb(word);
+                word = 0;
+            }
+        }
+        absorb(word | static_cast<uint64_t>(data.size()) << 56);
+
+        Digest digest;
+        v[2] ^= 0xee;
+        for (auto& half : digest) {
+            for (size_t round = 0; round < 4; round++)
+                sip_round(v);
+            half = v[0] ^ v[1] ^ v[2] ^ v[3];
+            v[1] ^= 0xdd;
+        }
+        return digest;
+    }
+
+    struct KeyCache {
+        KeyCache()
+        {
+            std::random_device random;
+            for (auto& half : secret)
+                half = static_cast<uint64_t>(random()) << 32 | random();
+        }
+
+        mutex lookup_mutex;
+        array<uint64_t, 2> secret;
+        LruCache<Digest, Deck, DigestHash> entries { 0 };
+    };
+
+    KeyCache& key_cache()
+    {
+        static KeyCache cache;
+        return cache;
+    }
+}
+
+Deck key_deck(const span<const char> passphrase)
+{
+    // Only the letters count, so two passphrases that differ in case or
+    // punctuation share a cache entry.
+    vector<uint8_t> letters(passphrase.size());
+    letters.resize(normalize_letters(passphrase, letters));
+
+    auto& cache = key_cache();
+    const auto key = siphash(cache.secret, letters);
+    {
+        const lock_guard<mutex> lock(cache.lookup_mutex);
+        if (const auto found = cache.entries.find(key))
+            return *found;
+    }
+
+    KeystreamEngine engine(Deck(Deck::Kind::WITH_JOKERS));
+    for (const auto letter : letters) {
+        engine.step();
+        engine.count_cut(letter);
+    }
+    const auto deck = engine.deck();
+
+    const lock_guard<mutex> lock(cache.lookup_mutex);
+    cache.entries.insert(key, deck);
+    return deck;
+}
+
+void set_key_cache_capacity(const size_t passphrases)
+{
+    auto& cache = key_cache();
+    const lock_guard<mutex> lock(cache.lookup_mutex);
+    cache.entries = LruCache<Digest, Deck, DigestHash>(passphrases);
+}
+
+size_t key_cache_capacity()
+{
+    auto& cache = key_cache();
+    const lock_guard<mutex> lock(cache.lookup_mutex);
+    return cache.entries.capacity();
+}
+} // namespace The_Deck
@@ -0,0 +1,350 @@
+#include "cpu_features.h"
+#include "ordinals.h"
+#include "stats.h"
+#include "the_deck.h"
+#include <bitset>
+#include <cstring>
+
+using std::array;
+using std::invalid_argument;
+using std::length_error;
+using std::out_of_range;
+using std::span;
+using The_Deck::detail::card_ordinal;
+using The_Deck::detail::JOKER_A_ORDINAL;
+using The_Deck::detail::JOKER_B_ORDINAL;
+using The_Deck::detail::ordinal_value;
+
+namespace The_Deck {
+namespace {
+    template <size_t Lanes>
+    using Lane = array<uint8_t, Lanes>;
+
+    template <size_t Lanes>
+    using Positions = array<Lane<Lanes>, Deck::MAX_CARDS>;
+
+    // The bottom position, which is also the most a count cut can take.
+    constexpr uint8_t LAST = Deck::MAX_CARDS - 1;
+    constexpr uint8_t REJECTED = ordinal_value(JOKER_A_ORDINAL);
+
+#if defined(__GNUC__)
+// The 32-byte vectors only ever cross function boundaries inside the
+// always-inlined kernel, so GCC's note that their calling convention
+// depends on AVX doesn't apply.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+    // A vector of one byte per lane, courtesy of the compiler's vector
+    // extensions: arithmetic, comparisons and ?: all work lane by lane,
+    // and come out as SSE2 or AVX2 depending on the function's target.
+    // The bytes are signed, as every position and value fits and x86
+    // has no unsigned byte compare.
+    template <size_t Lanes>
+    struct LaneVector {
+        typedef int8_t type __attribute__((vector_size(Lanes)));
+    };
+    constexpr bool VECTOR_LANES = true;
+#else
+    template <size_t Lanes>
+    struct LaneVector {
+        using type = uint8_t;
+    };
+    constexpr bool VECTOR_LANES = false;
+#endif
+
+    template <typename V>
+    DECKY_ALWAYS_INLINE V load(const uint8_t* from)
+    {
+        V v;
+        std::memcpy(&v, from, sizeof v);
+        return v;
+    }
+
+    template <typename V>
+    DECKY_ALWAYS_INLINE void store(uint8_t* to, const V& v)
+    {
+        std::memcpy(to, &v, sizeof v);
+    }
+
+    template <typename V>
+    DECKY_ALWAYS_INLINE V splat(const uint8_t value)
+    {
+        return V {} + value;
+    }
+
+    // Where the card at `p` ends up when another card moves from `from`
+    // to `to`. Moving the card back from `to` to `from` undoes it.
+    template <typename V>
+    DECKY_ALWAYS_INLINE V displaced(const V& p, const V& from, const V& to)
+    {
+        const V up = (from < p) & (p <= to) ? V(p - 1) : p;
+        return (to <= p) & (p < from) ? V(p + 1) : up;
+    }
+
+    // Where a round's buries take the jokers, and where its triple cut
+    // splits the deck, for the decks whose card positions are `stride`
+    // bytes apart starting at `rows`.
+    template <typename V>
+    struct Buries {
+        V a;
+        V b;
+        V a_buried;
+        V b_moved;
+        V b_buried;
+        V a_final;
+        V low;
+        V high;
+
+        DECKY_ALWAYS_INLINE Buries(const uint8_t* rows, const size_t stride)
+            : a(load<V>(rows + JOKER_A_ORDINAL * stride))
+            , b(load<V>(rows + JOKER_B_ORDINAL * stride))
+            , a_buried(a == LAST ? splat<V>(1) : V(a + 1))
+            , b_moved(displaced<V>(b, a, a_buried))
+            , b_buried(b_moved >= LAST - 1 ? V(b_moved - (LAST - 2)) : V(b_moved + 2))
+            , a_final(displaced<V>(a_buried, b_moved, b_buried))
+            , low(a_final < b_buried ? a_final : b_buried)
+            , high(a_final < b_buried ? b_buried : a_final)
+        {
+        }
+
+        // Where the card the triple cut leaves on the bottom is before the
+        // buries: the card just above the upper joker or, with nothing
+        // above it, the lower joker. Either joker will do for that, as
+        // both are worth 53.
+        DECKY_ALWAYS_INLINE V bottom() const
+        {
+            const V above = low - 1;
+            return low == 0 ? a : displaced<V>(displaced<V>(above, b_buried, b_moved), a_buried, a);
+        }
+    };
+
+    // The cards' values are counted up as the loops below go down the
+    // cards, rather than spread across the lanes afresh for each one:
+    // 1 to 52 for the ordinary cards and 53 for both jokers.
+    //
+    // Which card a round's triple cut leaves on the bottom, and so its
+    // count cut, is known before the round starts: `cuts` holds it for
+    // each lane, worked out by next_cuts or the round before. The round's
+    // four operations are then one pass down the cards.
+    template <typename V>
+    DECKY_ALWAYS_INLINE V next_cuts(const uint8_t* rows, const size_t stride)
+    {
+        const auto bottom = Buries<V>(rows, stride).bottom();
+        V cuts {};
+        V value {};
+        for (uint8_t card = 0; card < Deck::MAX_CARDS; card++) {
+            if (card <= JOKER_A_ORDINAL)
+                value += 1;
+            cuts |= load<V>(rows + card * stride) == bottom ? value : V {};
+        }
+        return cuts;
+    }
+
+    // One round of Solitaire for as many lanes as V holds, on the decks
+    // whose card positions are `stride` bytes apart starting at `rows`.
+    // V is either a vector of lanes or a single byte, and the same code
+    // serves for both: nothing branches on a lane, it's all compares and
+    // selects.
+    //
+    // Each lane's keystream value (or 53) lands in `values`. Lanes whose
+    // `active` byte is zero are left as they are.
+    template <typename V>
+    DECKY_ALWAYS_INLINE void round_kernel(uint8_t* rows, const size_t stride,
+        const uint8_t* active_lanes, uint8_t* cut_lanes, uint8_t* values)
+    {
+        const auto active = load<V>(active_lanes) != 0;
+        const Buries<V> buries(rows, stride);
+        const V one = splat<V>(1);
+        const V below = splat<V>(LAST) - buries.high;
+        const V between = buries.high - buries.low - 1;
+        const auto cut = load<V>(cut_lanes);
+        const V wrap = LAST - cut;
+        const auto count_cut = [&](const V& tripled) -> V {
+            const V wrapped = tripled >= cut ? V(tripled - cut) : V(tripled + wrap);
+            return tripled == LAST ? tripled : wrapped;
+        };
+
+        // The buries leave the ordinary cards in order, so where one ends
+        // up after the triple cut follows from its place among them: it's
+        // in the cards above the jokers, between them or below them, and
+        // each of those moves by a set amount.
+        const V top_shift = below + between + 2;
+        const V middle_shift = below + 1 - buries.low;
+        const V bottom_shift = one - buries.high;
+        const V middle_end = buries.high - 1;
+
+        // All four operations, noting the value of whichever card lands
+        // on top.
+        V top {};
+        V value {};
+        for (uint8_t card = 0; card < JOKER_A_ORDINAL; card++) {
+            auto* row = rows + card * stride;
+            value += 1;
+            const auto p = load<V>(row);
+            const V rank = p - (buries.a < p ? one : V {}) - (buries.b < p ? one : V {});
+            const V shift = rank < buries.low ? top_shift
+                : rank < middle_end           ? middle_shift
+                                              : bottom_shift;
+            const auto moved = count_cut(rank + shift);
+            top |= moved == 0 ? value : V {};
+            store(row, active ? moved : p);
+        }
+        const auto first = count_cut(below);
+        const auto second = count_cut(below + between + 1);
+        const auto a_first = buries.a_final < buries.b_buried;
+        const V a_at = a_first ? first : second;
+        const V b_at = a_first ? second : first;
+        top |= (first == 0) | (second == 0) ? splat<V>(REJECTED) : V {};
+        store(rows + JOKER_A_ORDINAL * stride, active ? a_at : buries.a);
+        store(rows + JOKER_B_ORDINAL * stride, active ? b_at : buries.b);
+
+        // The output is the card as far down as the top card's value. The
+        // same pass finds the next round's count cut.
+        const auto bottom = Buries<V>(rows, stride).bottom();
+        V output {};
+        V next {};
+        value = V {};
+        for (uint8_t card = 0; card < Deck::MAX_CARDS; card++) {
+            if (card <= JOKER_A_ORDINAL)
+                value += 1;
+            const auto p = load<V>(rows + card * stride);
+            output |= p == top ? value : V {};
+            next |= p == bottom ? value : V {};
+        }
+        store(values, output);
+        store(cut_lanes, next);
+    }
+
+    template <size_t Lanes>
+    DECKY_ALWAYS_INLINE void round_lanes(Positions<Lanes>& positions,
+        const Lane<Lanes>& active, Lane<Lanes>& cuts, Lane<Lanes>& values)
+    {
+        if constexpr (VECTOR_LANES) {
+            round_kernel<typename LaneVector<Lanes>::type>(positions[0].data(), Lanes,
+                active.data(), cuts.data(), values.data());
+        } else {
+            for (size_t l = 0; l < Lanes; l++)
+                round_kernel<uint8_t>(positions[0].data() + l, Lanes, active.data() + l,
+                    cuts.data() + l, values.data() + l);
+        }
+    }
+
+    template <size_t Lanes>
+    void round_default(Positions<Lanes>& positions, const Lane<Lanes>& active, Lane<Lanes>& cuts,
+        Lane<Lanes>& values)
+    {
+        round_lanes(positions, active, cuts, values);
+    }
+
+#ifdef DECKY_AVX2
+    template <size_t Lanes>
+    DECKY_TARGET_AVX2 void round_avx2(Positions<Lanes>& positions, const Lane<Lanes>& active,
+        Lane<Lanes>& cuts, Lane<Lanes>& values)
+    {
+        round_lanes(positions, active, cuts, values);
+    }
+#endif
+
+    template <size_t Lanes>
+    auto round_function()
+    {
+#ifdef DECKY_AVX2
+        if (detail::have_avx2())
+            return &round_avx2<Lanes>;
+#endif
+        return &round_default<Lanes>;
+    }
+}
+
+template <size_t Lanes>
+LaneEngine<Lanes>::LaneEngine(const span<const Deck> decks)
+{
+    if (decks.size() != Lanes)
+        throw invalid_argument("LaneEngine: there must be exactly one deck per lane");
+    for (size_t lane = 0; lane < Lanes; lane++) {
+        const auto& deck = decks[lane];
+        if (deck.size() != Deck::MAX_CARDS)
+            throw invalid_argument("LaneEngine: every deck must be a full deck");
+        std::bitset<Deck::MAX_CARDS> seen;
+        for (size_t i = 0; i < Deck::MAX_CARDS; i++) {
+            const auto ordinal = card_ordinal(deck.deck[i]);
+            if (ordinal >= Deck::MAX_CARDS || seen[ordinal])
+                throw invalid_argument("LaneEngine: every deck must be a full deck");
+            seen[ordinal] = true;
+            positions[ordinal][lane] = static_cast<uint8_t>(i);
+        }
+        cuts[lane] = next_cuts<uint8_t>(positions[0].data() + lane, Lanes);
+    }
+}
+
+template <size_t Lanes>
+array<uint8_t, Lanes> LaneEngine<Lanes>::step()
+{
+    Lane<Lanes> active;
+    active.fill(1);
+    Lane<Lanes> values;
+    round_function<Lanes>()(positions, active, cuts, values);
+    detail::count(detail::Stat::KEYSTREAM_STEPS, Lanes);
+    return values;
+}
+
+template <size_t Lanes>
+void LaneEngine<Lanes>::generate_raw(const span<uint8_t> output)
+{
+    if (output.size() % Lanes)
+        throw length_error("LaneEngine: the output must hold the same number of values for every lane");
+    const auto count = output.size() / Lanes;
+    if (count == 0)
+        return;
+
+    const auto round = round_function<Lanes>();
+    array<size_t, Lanes> filled {};
+    Lane<Lanes> active;
+    active.fill(1);
+    size_t running = Lanes;
+    uint64_t steps = 0;
+    while (running > 0) {
+        Lane<Lanes> values;
+        round(positions, active, cuts, values);
+        for (size_t l = 0; l < Lanes; l++) {
+            if (!active[l])
+                continue;
+            steps += 1;
+            if (values[l] == REJECTED)
+                continue;
+            output[l * count + filled[l]++] = values[l];
+            if (filled[l] == count) {
+                active[l] = 0;
+                running -= 1;
+            }
+        }
+    }
+    detail::count(detail::Stat::KEYSTREAM_STEPS, steps);
+    detail::count(detail::Stat::JOKER_REJECTIONS, steps - output.size());
+}
+
+template <size_t Lanes>
+void LaneEngine<Lanes>::generate(const span<uint8_t> output)
+{
+    generate_raw(output);
+    for (auto& value : output)
+        value = static_cast<uint8_t>(value - 26 * (value > 26));
+}
+
+template <size_t Lanes>
+Deck LaneEngine<Lanes>::deck(const size_t lane) const
+{
+    if (lane >= Lanes)
+        throw out_of_range("LaneEngine: no such lane");
+    array<uint8_t, Deck::MAX_CARDS> ordinals {};
+    for (uint8_t card = 0; card < Deck::MAX_CARDS; card++)
+        ordinals[positions[card][lane]] = card;
+    FixedVector<PackedCard, Deck::MAX_CARDS> cards;
+    for (const auto ordinal : ordinals)
+        cards.push_back(PackedCard(ordinal));
+    return Deck(span<const PackedCard>(cards.data(), cards.size()));
+}
+
+template class DLL_API LaneEngine<8>;
+template class DLL_API LaneEngine<16>;
+template class DLL_API LaneEngine<32>;
+} // namespace The_Deck
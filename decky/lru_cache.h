@@ -0,0 +1,68 @@
+#ifndef DECKY_LRU_CACHE_H
+#define DECKY_LRU_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/* A library-internal, bounded, least-recently-used map. It isn't
+ * thread-safe on its own: callers hold their own lock around it. */
+
+namespace The_Deck::detail {
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+    using Entries = std::list<std::pair<Key, Value>>;
+
+    std::size_t limit;
+    Entries entries; // most recently used first
+    std::unordered_map<Key, typename Entries::iterator, Hash> lookup;
+
+public:
+    explicit LruCache(const std::size_t capacity)
+        : limit { capacity }
+    {
+    }
+
+    std::size_t capacity() const { return limit; }
+    std::size_t size() const { return entries.size(); }
+
+    /* Returns the value stored under the key, or nullptr, and marks the
+     * entry as the most recently used. */
+    Value* find(const Key& key)
+    {
+        const auto found = lookup.find(key);
+        if (found == lookup.end())
+            return nullptr;
+        entries.splice(entries.begin(), entries, found->second);
+        return &found->second->second;
+    }
+
+    /* Stores a value under the key, replacing any value already there and
+     * evicting the least recently used entry if the cache is full. With a
+     * capacity of zero nothing is stored, and this returns nullptr. */
+    Value* insert(const Key& key, Value value)
+    {
+        if (limit == 0)
+            return nullptr;
+        if (auto existing = find(key)) {
+            *existing = std::move(value);
+            return existing;
+        }
+        if (entries.size() == limit) {
+            lookup.erase(entries.back().first);
+            entries.pop_back();
+        }
+        entries.emplace_front(key, std::move(value));
+        lookup.emplace(key, entries.begin());
+        return &entries.front().second;
+    }
+
+    void clear()
+    {
+        lookup.clear();
+        entries.clear();
+    }
+};
+} // namespace The_Deck::detail
+#endif
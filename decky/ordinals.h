@@ -0,0 +1,42 @@
+#ifndef DECKY_ORDINALS_H
+#define DECKY_ORDINALS_H
+
+#include "the_deck.h"
+
+/* Library-internal helpers for mapping cards to and from their ordinals:
+ * 0-51 for the ordinary cards in Card(int32_t) order, then 52 for joker A
+ * and 53 for joker B. These aren't part of the installed API. */
+
+namespace The_Deck::detail {
+constexpr uint8_t JOKER_A_ORDINAL = PackedCard::JOKER_A;
+constexpr uint8_t JOKER_B_ORDINAL = PackedCard::JOKER_B;
+
+/* Returns the card's ordinal, or Deck::MAX_CARDS for a card that isn't
+ * one of the standard fifty-four. */
+inline size_t card_ordinal(const Card& card)
+{
+    const auto suit = static_cast<size_t>(card.SUIT);
+    const auto rank = static_cast<size_t>(card.RANK);
+    if (suit < 4)
+        return rank < 13 ? suit * 13 + rank : Deck::MAX_CARDS;
+    if (card.RANK == Card::Rank::JOKER_A)
+        return JOKER_A_ORDINAL;
+    if (card.RANK == Card::Rank::JOKER_B)
+        return JOKER_B_ORDINAL;
+    return Deck::MAX_CARDS;
+}
+
+/* The inverse of card_ordinal for ordinals in 0-53. */
+inline Card ordinal_card(const size_t ordinal)
+{
+    return PackedCard(static_cast<uint8_t>(ordinal));
+}
+
+/* The value Solitaire counts with: 1-52 for the ordinary cards and 53
+ * for either joker. */
+constexpr uint8_t ordinal_value(const uint8_t ordinal)
+{
+    return static_cast<uint8_t>(std::min<uint8_t>(ordinal, 52) + 1);
+}
+} // namespace The_Deck::detail
+#endif
@@ -0,0 +1,130 @@
+#include "the_deck.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <string>
+
+using std::function;
+using std::invalid_argument;
+using std::istream;
+using std::lock_guard;
+using std::min;
+using std::mutex;
+using std::span;
+using std::string;
+using std::vector;
+
+namespace The_Deck {
+namespace {
+    // Lines read per batch, and lines per unit of work within a batch.
+    constexpr size_t BATCH_LINES = 1 << 16;
+    constexpr size_t LINES_PER_TASK = 256;
+
+    // A batch of lines from the word list, laid end to end, and where
+    // each one ends. Everything keeps its capacity from batch to batch.
+    struct Batch {
+        string text;
+        vector<size_t> ends;
+        string buffer;
+
+        [[nodiscard]] size_t size() const { return ends.size(); }
+
+        [[nodiscard]] span<const char> line(const size_t i) const
+        {
+            const auto begin = i ? ends[i - 1] : 0;
+            return span(text).subspan(begin, ends[i] - begin);
+        }
+
+        bool fill(istream& words)
+        {
+            text.clear();
+            ends.clear();
+            while (ends.size() < BATCH_LINES && std::getline(words, buffer)) {
+                if (!buffer.empty() && buffer.back() == '\r')
+                    buffer.pop_back();
+                text += buffer;
+                ends.push_back(text.size());
+            }
+            return !ends.empty();
+        }
+    };
+
+    // Keys a copy of the ordered deck from the passphrase as key_deck
+    // does, then checks it against the keystream the crib calls for,
+    // giving up at the first value that differs.
+    bool matches(const KeystreamEngine& ordered, const span<const char> passphrase,
+        const span<const uint8_t> keystream)
+    {
+        auto engine = ordered;
+        for (const auto c : passphrase) {
+            // The same letter test normalize_letters makes.
+            const auto offset = static_cast<uint8_t>((static_cast<uint8_t>(c) & 0xDF) - 'A');
+            if (offset < 26) {
+                engine.step();
+                engine.count_cut(offset + 1);
+            }
+        }
+        for (const auto value : keystream)
+            if (engine.next() != value)
+                return false;
+        return true;
+    }
+}
+
+vector<string> search_passphrases(istream& words, const span<const char> ciphertext,
+    const span<const char> crib, const function<void(const SearchProgress&)>& progress)
+{
+    vector<uint8_t> crib_letters(crib.size());
+    crib_letters.resize(normalize_letters(crib, crib_letters));
+    vector<uint8_t> cipher_letters(ciphertext.size());
+    cipher_letters.resize(normalize_letters(ciphertext, cipher_letters));
+    if (crib_letters.empty())
+        throw invalid_argument("search_passphrases: the crib has no letters");
+    if (crib_letters.size() > cipher_letters.size())
+        throw invalid_argument("search_passphrases: the crib is longer than the ciphertext");
+
+    // The keystream that turns the crib into the ciphertext, which is all
+    // a candidate has to reproduce.
+    vector<uint8_t> keystream(crib_letters.size());
+    for (size_t i = 0; i < keystream.size(); i++) {
+        int value = cipher_letters[i] - crib_letters[i];
+        value += 26 * (value < 1);
+        keystream[i] = static_cast<uint8_t>(value);
+    }
+
+    const KeystreamEngine ordered(Deck(Deck::Kind::WITH_JOKERS));
+    const auto pool = detail::shared_pool();
+    const auto start = std::chrono::steady_clock::now();
+    SearchProgress status;
+    vector<string> found;
+    vector<size_t> hits;
+    mutex hits_mutex;
+    Batch batch;
+
+    while (batch.fill(words)) {
+        hits.clear();
+        const auto tasks = (batch.size() + LINES_PER_TASK - 1) / LINES_PER_TASK;
+        pool->parallel_for(tasks, [&](const size_t task) {
+            const auto first = task * LINES_PER_TASK;
+            const auto last = min(first + LINES_PER_TASK, batch.size());
+            for (auto i = first; i < last; i++) {
+                if (matches(ordered, batch.line(i), keystream)) {
+                    const lock_guard<mutex> lock(hits_mutex);
+                    hits.push_back(i);
+                }
+            }
+        });
+
+        std::sort(hits.begin(), hits.end());
+        for (const auto i : hits) {
+            const auto line = batch.line(i);
+            found.emplace_back(line.begin(), line.end());
+        }
+        status.candidates += batch.size();
+        status.matches += hits.size();
+        status.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (progress)
+            progress(status);
+    }
+    return found;
+}
+} // namespace The_Deck
@@ -0,0 +1,205 @@
+#include "cpu_features.h"
+#include "the_deck.h"
+#include <bit>
+
+using std::length_error;
+using std::span;
+
+namespace The_Deck {
+namespace {
+    // Upper-casing an ASCII letter just clears bit 5, and after that a
+    // single unsigned comparison tells the letters from everything else.
+    // Each byte's value is written whether or not it's a letter; only
+    // letters advance the output.
+    size_t normalize_scalar(const char* in, const size_t size, uint8_t* out)
+    {
+        size_t written = 0;
+        for (size_t i = 0; i < size; i++) {
+            const auto offset = static_cast<uint8_t>((static_cast<uint8_t>(in[i]) & 0xDF) - 'A');
+            out[written] = offset + 1;
+            written += offset < 26;
+        }
+        return written;
+    }
+
+    // Writes out the lanes whose bits are set in the mask.
+    size_t compact(const uint8_t* lanes, uint32_t mask, uint8_t* out)
+    {
+        size_t written = 0;
+        for (; mask; mask &= mask - 1)
+            out[written++] = lanes[std::countr_zero(mask)];
+        return written;
+    }
+
+#ifdef DECKY_SSE2
+    size_t normalize_sse2(const char* in, const size_t size, uint8_t* out)
+    {
+        const auto case_bit = _mm_set1_epi8(static_cast<char>(0xDF));
+        const auto letter_a = _mm_set1_epi8('A');
+        const auto last_offset = _mm_set1_epi8(25);
+        const auto one = _mm_set1_epi8(1);
+        size_t i = 0;
+        size_t written = 0;
+
+        for (; i + 16 <= size; i += 16) {
+            const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            const auto offsets = _mm_sub_epi8(_mm_and_si128(bytes, case_bit), letter_a);
+            const auto letters = _mm_cmpeq_epi8(_mm_min_epu8(offsets, last_offset), offsets);
+            const auto values = _mm_add_epi8(offsets, one);
+            const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(letters));
+            if (mask == 0xFFFF) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), values);
+                written += 16;
+            } else if (mask) {
+                alignas(16) uint8_t lanes[16];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanes), values);
+                written += compact(lanes, mask, out + written);
+            }
+        }
+        return written + normalize_scalar(in + i, size - i, out + written);
+    }
+#endif
+
+    // Adding (or subtracting) a keystream value in 1..26 to a letter in
+    // 1..26 can overshoot the range by at most 26 either way, so a single
+    // masked correction in each direction brings it back.
+    void combine_scalar(const uint8_t* values, const uint8_t* keystream,
+        uint8_t* out, const size_t size, const Opmode mode)
+    {
+        const int sign = mode == Opmode::ENCRYPT ? 1 : -1;
+        for (size_t i = 0; i < size; i++) {
+            int v = values[i] + sign * keystream[i];
+            v += 26 * (v < 1) - 26 * (v > 26);
+            out[i] = static_cast<uint8_t>('A' - 1 + v);
+        }
+    }
+
+#ifdef DECKY_SSE2
+    size_t combine_sse2(const uint8_t* values, const uint8_t* keystream,
+        uint8_t* out, const size_t size, const Opmode mode)
+    {
+        const auto one = _mm_set1_epi8(1);
+        const auto twenty_six = _mm_set1_epi8(26);
+        const auto letter_base = _mm_set1_epi8('A' - 1);
+        size_t i = 0;
+
+        for (; i + 16 <= size; i += 16) {
+            const auto text = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+            const auto key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keystream + i));
+            auto v = mode == Opmode::ENCRYPT ? _mm_add_epi8(text, key) : _mm_sub_epi8(text, key);
+            v = _mm_add_epi8(v, _mm_and_si128(_mm_cmplt_epi8(v, one), twenty_six));
+            v = _mm_sub_epi8(v, _mm_and_si128(_mm_cmpgt_epi8(v, twenty_six), twenty_six));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_add_epi8(v, letter_base));
+        }
+        return i;
+    }
+#endif
+
+#ifdef DECKY_AVX2
+    // For each 8-bit mask, the shuffle that packs the selected bytes of an
+    // 8-byte group down to the front.
+    constexpr auto compaction_table = [] {
+        std::array<uint64_t, 256> table {};
+        for (uint32_t mask = 0; mask < 256; mask++) {
+            size_t lane = 0;
+            for (uint64_t bit = 0; bit < 8; bit++)
+                if (mask & (1U << bit))
+                    table[mask] |= bit << (8 * lane++);
+        }
+        return table;
+    }();
+
+    DECKY_TARGET_AVX2
+    size_t normalize_avx2(const char* in, const size_t size, uint8_t* out)
+    {
+        const auto case_bit = _mm256_set1_epi8(static_cast<char>(0xDF));
+        const auto letter_a = _mm256_set1_epi8('A');
+        const auto last_offset = _mm256_set1_epi8(25);
+        const auto one = _mm256_set1_epi8(1);
+        size_t i = 0;
+        size_t written = 0;
+
+        for (; i + 32 <= size; i += 32) {
+            const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            const auto offsets = _mm256_sub_epi8(_mm256_and_si256(bytes, case_bit), letter_a);
+            const auto letters = _mm256_cmpeq_epi8(_mm256_min_epu8(offsets, last_offset), offsets);
+            const auto values = _mm256_add_epi8(offsets, one);
+            const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(letters));
+            if (mask == 0xFFFFFFFF) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + written), values);
+                written += 32;
+            } else if (mask) {
+                alignas(32) uint8_t lanes[32];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), values);
+                for (size_t group = 0; group < 4; group++) {
+                    const auto bits = (mask >> (8 * group)) & 0xFF;
+                    const auto packed = _mm_shuffle_epi8(
+                        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(lanes + 8 * group)),
+                        _mm_cvtsi64_si128(static_cast<long long>(compaction_table[bits])));
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + written), packed);
+                    written += std::popcount(bits);
+                }
+            }
+        }
+        return written + normalize_sse2(in + i, size - i, out + written);
+    }
+
+    DECKY_TARGET_AVX2
+    size_t combine_avx2(const uint8_t* values, const uint8_t* keystream,
+        uint8_t* out, const size_t size, const Opmode mode)
+    {
+        const auto one = _mm256_set1_epi8(1);
+        const auto twenty_six = _mm256_set1_epi8(26);
+        const auto letter_base = _mm256_set1_epi8('A' - 1);
+        size_t i = 0;
+
+        for (; i + 32 <= size; i += 32) {
+            const auto text = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+            const auto key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keystream + i));
+            auto v = mode == Opmode::ENCRYPT ? _mm256_add_epi8(text, key) : _mm256_sub_epi8(text, key);
+            v = _mm256_add_epi8(v, _mm256_and_si256(_mm256_cmpgt_epi8(one, v), twenty_six));
+            v = _mm256_sub_epi8(v, _mm256_and_si256(_mm256_cmpgt_epi8(v, twenty_six), twenty_six));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi8(v, letter_base));
+        }
+        return i;
+    }
+#endif
+}
+
+size_t normalize_letters(const span<const char> input, const span<uint8_t> output)
+{
+    if (output.size() < input.size())
+        throw length_error("normalize_letters: the output buffer is too small");
+
+#if defined(DECKY_AVX2)
+    if (detail::have_avx2())
+        return normalize_avx2(input.data(), input.size(), output.data());
+#endif
+#if defined(DECKY_SSE2)
+    return normalize_sse2(input.data(), input.size(), output.data());
+#else
+    return normalize_scalar(input.data(), input.size(), output.data());
+#endif
+}
+
+void combine_keystream(const span<const uint8_t> values,
+    const span<const uint8_t> keystream, const span<uint8_t> output,
+    const Opmode mode)
+{
+    if (keystream.size() < values.size() || output.size() < values.size())
+        throw length_error("combine_keystream: the buffers are too small");
+
+    size_t done = 0;
+#if defined(DECKY_AVX2)
+    if (detail::have_avx2())
+        done = combine_avx2(values.data(), keystream.data(), output.data(),
+            values.size(), mode);
+#endif
+#if defined(DECKY_SSE2)
+    done += combine_sse2(values.data() + done, keystream.data() + done,
+        output.data() + done, values.size() - done, mode);
+#endif
+    combine_scalar(values.data() + done, keystream.data() + done,
+        output.data() + done, values.size() - done, mode);
+}
+} // namespace The_Deck
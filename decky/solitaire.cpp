@@ -1,34 +1,195 @@
+#include "cache.h"
+#include "stats.h"
 #include "the_deck.h"
 #include <fstream>
 #include <ranges>
 #include <string>
 
-using std::back_inserter;
 using std::istream;
-using std::istream_iterator;
+using std::logic_error;
 using std::ostream;
-using std::ostream_iterator;
 using std::span;
 using std::string;
 using std::vector;
 using std::ranges::remove_if;
-using std::views::filter;
 using std::views::transform;
+using The_Deck::detail::LatencyTimer;
+using The_Deck::detail::Stat;
+using The_Deck::detail::TimedCall;
 
 namespace The_Deck {
-uint8_t get_raw_keystream_value(Deck& deck)
+namespace {
+    // How much input the streaming interfaces read at a time.
+    constexpr size_t CHUNK_SIZE = 1 << 16;
+
+    // Appends letters (A-Z) to the output in the given format, as letters
+    // `position` onwards of the message. The callbacks work out the final
+    // size themselves: libstdc++ 12 hands resize_and_overwrite's callback
+    // the new capacity rather than the requested size when it reallocates.
+    void append_formatted(const span<const uint8_t> letters, const uint64_t position,
+        const OutputFormat format, string& output)
+    {
+        const auto old_size = output.size();
+        if (format == OutputFormat::GROUPED) {
+            const auto bound = letters.size() + letters.size() / 5 + 1;
+            output.resize_and_overwrite(old_size + bound, [&](char* data, size_t) {
+                return old_size + format_groups(letters, position, span(data + old_size, bound));
+            });
+            return;
+        }
+        const auto base = format == OutputFormat::VALUES ? 'A' - 1 : 0;
+        output.resize_and_overwrite(old_size + letters.size(), [&](char* data, size_t) {
+            for (size_t i = 0; i < letters.size(); i++)
+                data[old_size + i] = static_cast<char>(letters[i] - base);
+            return old_size + letters.size();
+        });
+    }
+
+    // Runs a stream's worth of input through a context a chunk at a time,
+    // writing each chunk's output before the next one is looked at.
+    class ChunkCrypter {
+    public:
+        ChunkCrypter(const Deck& deck, const Opmode mode, ostream& output)
+            : context { deck, mode }
+            , output { output }
+        {
+            formatted.reserve(2 * CHUNK_SIZE);
+        }
+
+        void update(span<const char> input)
+        {
+            while (!input.empty()) {
+                const auto chunk = input.first(std::min(input.size(), CHUNK_SIZE));
+                context.update(chunk, formatted);
+                flush();
+                input = input.subspan(chunk.size());
+            }
+        }
+
+        void finish()
+        {
+            context.finalize(formatted);
+            flush();
+        }
+
+    private:
+        SolitaireContext context;
+        ostream& output;
+        string formatted;
+
+        void flush()
+        {
+            output.write(formatted.data(), static_cast<std::streamsize>(formatted.size()));
+            formatted.clear();
+        }
+    };
+
+    void stream_crypt(istream& input, ostream& output, const Deck& deck,
+        const Opmode mode)
+    {
+        ChunkCrypter crypter(deck, mode, output);
+        vector<char> chunk(CHUNK_SIZE);
+        while (input.read(chunk.data(), CHUNK_SIZE) || input.gcount() > 0)
+            crypter.update(span(chunk).first(static_cast<size_t>(input.gcount())));
+        crypter.finish();
+    }
+}
+
+SolitaireContext::SolitaireContext(const Deck& deck, const Opmode mode,
+    const OutputFormat format)
+    : generator { deck }
+    , mode { mode }
+    , format { format }
+{
+}
+
+SolitaireContext::SolitaireContext(const Deck& deck, const Opmode mode,
+    const size_t checkpoint_interval, const OutputFormat format)
+    : generator { deck }
+    , mode { mode }
+    , format { format }
+    , index { std::in_place, deck, checkpoint_interval }
 {
-    uint8_t ks_val = 53;
+}
+
+const KeystreamIndex& SolitaireContext::checkpoints() const
+{
+    if (!index)
+        throw logic_error("SolitaireContext: this context isn't recording checkpoints");
+    return *index;
+}
 
-    while (ks_val == 53) {
-        deck.bury_joker_a();
-        deck.bury_joker_b();
-        deck.triple_cut();
-        deck.count_cut();
-        ks_val = deck.get_keystream_value();
+void SolitaireContext::update(const span<const char> input, string& output)
+{
+    if (finalized)
+        throw logic_error("SolitaireContext: the message has already been finalized");
+
+    detail::count(Stat::BYTES_IN, input.size());
+    for (size_t done = 0; done < input.size(); done += CHUNK_SIZE) {
+        const auto chunk = input.subspan(done, std::min(input.size() - done, CHUNK_SIZE));
+        if (values.size() < chunk.size())
+            values.resize(chunk.size());
+        emit(normalize_letters(chunk, values), output);
     }
+}
 
-    return ks_val;
+void SolitaireContext::finalize(string& output)
+{
+    if (finalized)
+        throw logic_error("SolitaireContext: the message has already been finalized");
+    finalized = true;
+
+    size_t padding = 0;
+    if (values.size() < 5)
+        values.resize(5);
+    while ((count + padding) % 5)
+        values[padding++] = 'X' - 'A' + 1;
+    emit(padding, output);
+}
+
+// Runs the first `size` letter values through the keystream and appends
+// them to the output in the context's format.
+void SolitaireContext::emit(const size_t size, string& output)
+{
+    if (key.size() < size)
+        key.resize(size);
+    const auto letters = span(values).first(size);
+    if (!index) {
+        // The first letters' keystream is the deck's keystream prefix, so
+        // it can come from the cache, if that's on. Only what this piece
+        // needs is copied out of it, and the generator takes over where
+        // the cached keystream runs out.
+        if (!cache_checked) {
+            cache_checked = true;
+            cached = detail::find_cached_keystream(generator, cached_size);
+        }
+        size_t from_cache = 0;
+        if (cached && count < cached_size) {
+            from_cache = std::min<size_t>(size, cached_size - count);
+            detail::read_cached_keystream(*cached, count, span(key).first(from_cache));
+            if (count + from_cache == cached_size) {
+                generator = detail::cached_keystream_end(*cached, cached_size);
+                cached.reset();
+            }
+        }
+        generator.generate(span(key).subspan(from_cache, size - from_cache));
+    } else {
+        // Stop at each multiple of the interval to take a checkpoint.
+        for (size_t done = 0; done < size;) {
+            const auto position = count + done;
+            const auto piece = std::min(size - done, index->every - position % index->every);
+            generator.generate(span(key).subspan(done, piece));
+            done += piece;
+            if ((position + piece) % index->every == 0)
+                index->append(generator.deck());
+        }
+    }
+    combine_keystream(letters, span(key).first(size), letters, mode);
+
+    const auto old_size = output.size();
+    append_formatted(letters, count, format, output);
+    count += size;
+    detail::count(Stat::BYTES_OUT, output.size() - old_size);
 }
 
 uint8_t get_keystream_value(Deck& deck)
@@ -47,14 +208,9 @@ uint8_t get_keystream_value(Deck& deck)
 
 vector<uint8_t> convert_string_to_uint8(string input_string)
 {
-    static const auto foo = [](const auto& x) { return ::toupper(x); };
-    static const auto bar = [](const auto& x) { return (x >= 'A' && x <= 'Z'); };
-    static const auto baz = [](const auto& x) {
-        return static_cast<uint8_t>(x - 'A' + 1);
-    };
-
-    auto quux = input_string | transform(foo) | filter(bar) | transform(baz);
-    return { quux.begin(), quux.end() };
+    vector<uint8_t> output(input_string.size());
+    output.resize(normalize_letters(input_string, output));
+    return output;
 }
 
 string convert_uint8_to_string(const span<const uint8_t> input_numbers)
@@ -66,10 +222,25 @@ string convert_uint8_to_string(const span<const uint8_t> input_numbers)
     return { letters.begin(), letters.end() };
 }
 
-string crypt(const string& input, const Deck& deck, const Opmode mode)
+string crypt(const string& input, const Deck& deck, const Opmode mode,
+    const OutputFormat format)
 {
+    const LatencyTimer timer(mode == Opmode::ENCRYPT ? TimedCall::ENCRYPT : TimedCall::DECRYPT);
+    vector<uint8_t> values(input.size() + 4);
+    auto letters = normalize_letters(input, values);
+    if (letters == 0)
+        return {};
+    while (letters % 5)
+        values[letters++] = 'X' - 'A' + 1;
+    values.resize(letters);
+    vector<uint8_t> key(letters);
+    fill_keystream(deck, key);
+    combine_keystream(values, key, values, mode);
+
     string output;
-    stl_crypt(input.cbegin(), input.cend(), back_inserter(output), deck, mode);
+    append_formatted(values, 0, format, output);
+    detail::count(Stat::BYTES_IN, input.size());
+    detail::count(Stat::BYTES_OUT, output.size());
     return output;
 }
 
@@ -83,38 +254,39 @@ string decrypt(const string& ciphertext, const Deck& deck)
     return crypt(ciphertext, deck, Opmode::DECRYPT);
 }
 
+void solitaire(const span<const char> input, ostream& output, const Deck& deck,
+    const Opmode mode)
+{
+    const LatencyTimer timer(TimedCall::SOLITAIRE);
+    ChunkCrypter crypter(deck, mode, output);
+    crypter.update(input);
+    crypter.finish();
+}
+
 void solitaire(istream&& input, ostream& output, const Deck& deck,
     Opmode mode)
 {
-    auto i = istream_iterator<uint8_t>(input);
-    auto eof = istream_iterator<uint8_t>();
-    auto o = ostream_iterator<uint8_t>(output);
-    solitaire(i, eof, o, deck, mode);
+    const LatencyTimer timer(TimedCall::SOLITAIRE);
+    stream_crypt(input, output, deck, mode);
 }
 
 void solitaire(istream& input, ostream& output, const Deck& deck, Opmode mode)
 {
-    auto i = istream_iterator<uint8_t>(input);
-    auto eof = istream_iterator<uint8_t>();
-    auto o = ostream_iterator<uint8_t>(output);
-    solitaire(i, eof, o, deck, mode);
+    const LatencyTimer timer(TimedCall::SOLITAIRE);
+    stream_crypt(input, output, deck, mode);
 }
 
 void solitaire(istream&& input, ostream&& output, const Deck& deck,
     Opmode mode)
 {
-    auto i = istream_iterator<uint8_t>(input);
-    auto eof = istream_iterator<uint8_t>();
-    auto o = ostream_iterator<uint8_t>(output);
-    solitaire(i, eof, o, deck, mode);
+    const LatencyTimer timer(TimedCall::SOLITAIRE);
+    stream_crypt(input, output, deck, mode);
 }
 
 void solitaire(istream& input, ostream&& output, const Deck& deck,
     Opmode mode)
 {
-    auto i = istream_iterator<uint8_t>(input);
-    auto eof = istream_iterator<uint8_t>();
-    auto o = ostream_iterator<uint8_t>(output);
-    solitaire(i, eof, o, deck, mode);
+    const LatencyTimer timer(TimedCall::SOLITAIRE);
+    stream_crypt(input, output, deck, mode);
 }
 } // namespace The_Deck
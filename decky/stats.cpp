@@ -0,0 +1,203 @@
+#include "stats.h"
+#include "the_deck.h"
+#include <atomic>
+#include <bit>
+#include <string>
+
+using std::atomic;
+using std::lock_guard;
+using std::memory_order_relaxed;
+using std::mutex;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace The_Deck {
+namespace {
+    constexpr auto STAT_COUNT = static_cast<size_t>(detail::Stat::COUNT);
+    constexpr auto CALL_COUNT = static_cast<size_t>(detail::TimedCall::COUNT);
+    constexpr size_t BUCKETS = 64;
+
+    struct LatencyCounters {
+        atomic<uint64_t> calls { 0 };
+        atomic<uint64_t> total_ns { 0 };
+        std::array<atomic<uint64_t>, BUCKETS> buckets {};
+    };
+
+    // One thread's counters. Only the owning thread adds to them, so the
+    // additions never contend; they're atomic so that snapshots and resets
+    // from other threads see whole values.
+    struct ThreadCounters {
+        std::array<atomic<uint64_t>, STAT_COUNT> stats {};
+        std::array<LatencyCounters, CALL_COUNT> latencies;
+    };
+
+    // Every live thread's counters, plus the totals of threads that have
+    // exited.
+    struct Registry {
+        mutex registry_mutex;
+        vector<ThreadCounters*> live;
+        ThreadCounters retired;
+    };
+
+    Registry& registry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    void add(atomic<uint64_t>& counter, const uint64_t amount)
+    {
+        counter.fetch_add(amount, memory_order_relaxed);
+    }
+
+    void fold(ThreadCounters& into, const ThreadCounters& from)
+    {
+        for (size_t i = 0; i < STAT_COUNT; i++)
+            add(into.stats[i], from.stats[i].load(memory_order_relaxed));
+        for (size_t call = 0; call < CALL_COUNT; call++) {
+            auto& to = into.latencies[call];
+            const auto& latency = from.latencies[call];
+            add(to.calls, latency.calls.load(memory_order_relaxed));
+            add(to.total_ns, latency.total_ns.load(memory_order_relaxed));
+            for (size_t i = 0; i < BUCKETS; i++)
+                add(to.buckets[i], latency.buckets[i].load(memory_order_relaxed));
+        }
+    }
+
+    void clear(ThreadCounters& counters)
+    {
+        for (auto& stat : counters.stats)
+            stat.store(0, memory_order_relaxed);
+        for (auto& latency : counters.latencies) {
+            latency.calls.store(0, memory_order_relaxed);
+            latency.total_ns.store(0, memory_order_relaxed);
+            for (auto& bucket : latency.buckets)
+                bucket.store(0, memory_order_relaxed);
+        }
+    }
+
+    // Registers the thread's counters on first use and folds them into
+    // the retired totals when the thread exits.
+    struct ThreadSlot {
+        ThreadCounters counters;
+
+        ThreadSlot()
+        {
+            auto& all = registry();
+            const lock_guard<mutex> lock(all.registry_mutex);
+            all.live.push_back(&counters);
+        }
+
+        ~ThreadSlot()
+        {
+            auto& all = registry();
+            const lock_guard<mutex> lock(all.registry_mutex);
+            fold(all.retired, counters);
+            std::erase(all.live, &counters);
+        }
+    };
+
+    ThreadCounters& thread_counters()
+    {
+        thread_local ThreadSlot slot;
+        return slot.counters;
+    }
+
+    void append_latency(string& json, const char* name,
+        const StatsSnapshot::Latency& latency)
+    {
+        json += string("\"") + name + "\":{\"calls\":" + to_string(latency.calls)
+            + ",\"total_ns\":" + to_string(latency.total_ns) + ",\"buckets\":[";
+        for (size_t i = 0; i < latency.buckets.size(); i++) {
+            if (i)
+                json += ',';
+            json += to_string(latency.buckets[i]);
+        }
+        json += "]}";
+    }
+}
+
+namespace detail {
+    void record_stat(const Stat stat, const uint64_t amount)
+    {
+        add(thread_counters().stats[static_cast<size_t>(stat)], amount);
+    }
+
+    void record_latency(const TimedCall call, const uint64_t nanoseconds)
+    {
+        auto& latency = thread_counters().latencies[static_cast<size_t>(call)];
+        add(latency.calls, 1);
+        add(latency.total_ns, nanoseconds);
+        add(latency.buckets[std::min<size_t>(std::bit_width(nanoseconds), BUCKETS - 1)], 1);
+    }
+}
+
+StatsSnapshot stats_snapshot()
+{
+    StatsSnapshot snapshot;
+    snapshot.enabled = detail::STATS_ENABLED;
+
+    ThreadCounters total;
+    {
+        auto& all = registry();
+        const lock_guard<mutex> lock(all.registry_mutex);
+        fold(total, all.retired);
+        for (const auto* counters : all.live)
+            fold(total, *counters);
+    }
+
+    const auto stat = [&](const detail::Stat which) {
+        return total.stats[static_cast<size_t>(which)].load(memory_order_relaxed);
+    };
+    snapshot.keystream_steps = stat(detail::Stat::KEYSTREAM_STEPS);
+    snapshot.joker_rejections = stat(detail::Stat::JOKER_REJECTIONS);
+    snapshot.deck_copies = stat(detail::Stat::DECK_COPIES);
+    snapshot.bytes_in = stat(detail::Stat::BYTES_IN);
+    snapshot.bytes_out = stat(detail::Stat::BYTES_OUT);
+    snapshot.keystream_cache_hits = stat(detail::Stat::KEYSTREAM_CACHE_HITS);
+    snapshot.keystream_cache_misses = stat(detail::Stat::KEYSTREAM_CACHE_MISSES);
+
+    const auto latency = [&](const detail::TimedCall call) {
+        const auto& counters = total.latencies[static_cast<size_t>(call)];
+        StatsSnapshot::Latency result;
+        result.calls = counters.calls.load(memory_order_relaxed);
+        result.total_ns = counters.total_ns.load(memory_order_relaxed);
+        for (size_t i = 0; i < BUCKETS; i++)
+            result.buckets[i] = counters.buckets[i].load(memory_order_relaxed);
+        return result;
+    };
+    snapshot.encrypt = latency(detail::TimedCall::ENCRYPT);
+    snapshot.decrypt = latency(detail::TimedCall::DECRYPT);
+    snapshot.solitaire = latency(detail::TimedCall::SOLITAIRE);
+    return snapshot;
+}
+
+void reset_stats()
+{
+    auto& all = registry();
+    const lock_guard<mutex> lock(all.registry_mutex);
+    clear(all.retired);
+    for (auto* counters : all.live)
+        clear(*counters);
+}
+
+string StatsSnapshot::to_json() const
+{
+    string json = string("{\"enabled\":") + (enabled ? "true" : "false")
+        + ",\"keystream_steps\":" + to_string(keystream_steps)
+        + ",\"joker_rejections\":" + to_string(joker_rejections)
+        + ",\"deck_copies\":" + to_string(deck_copies)
+        + ",\"bytes_in\":" + to_string(bytes_in)
+        + ",\"bytes_out\":" + to_string(bytes_out)
+        + ",\"keystream_cache_hits\":" + to_string(keystream_cache_hits)
+        + ",\"keystream_cache_misses\":" + to_string(keystream_cache_misses) + ",";
+    append_latency(json, "encrypt", encrypt);
+    json += ',';
+    append_latency(json, "decrypt", decrypt);
+    json += ',';
+    append_latency(json, "solitaire", solitaire);
+    json += '}';
+    return json;
+}
+} // namespace The_Deck
@@ -0,0 +1,76 @@
+#ifndef DECKY_STATS_H
+#define DECKY_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/* Library-internal hooks for the runtime statistics. They're only live
+ * when the library is built with DECKY_STATS defined (meson's `stats`
+ * option); otherwise every hook is an empty inline function and the
+ * compiler drops it, arguments and all. */
+
+namespace The_Deck::detail {
+#ifdef DECKY_STATS
+constexpr bool STATS_ENABLED = true;
+#else
+constexpr bool STATS_ENABLED = false;
+#endif
+
+enum class Stat : std::size_t {
+    KEYSTREAM_STEPS,
+    JOKER_REJECTIONS,
+    DECK_COPIES,
+    BYTES_IN,
+    BYTES_OUT,
+    KEYSTREAM_CACHE_HITS,
+    KEYSTREAM_CACHE_MISSES,
+    COUNT
+};
+
+enum class TimedCall : std::size_t {
+    ENCRYPT,
+    DECRYPT,
+    SOLITAIRE,
+    COUNT
+};
+
+void record_stat(Stat stat, std::uint64_t amount);
+void record_latency(TimedCall call, std::uint64_t nanoseconds);
+
+/* Adds to one of the calling thread's counters. */
+inline void count(const Stat stat, const std::uint64_t amount = 1)
+{
+    if constexpr (STATS_ENABLED)
+        record_stat(stat, amount);
+}
+
+/* Times the enclosing scope into the calling thread's histogram for one
+ * kind of call. */
+class LatencyTimer {
+public:
+    explicit LatencyTimer(const TimedCall call)
+        : call { call }
+    {
+        if constexpr (STATS_ENABLED)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~LatencyTimer()
+    {
+        if constexpr (STATS_ENABLED) {
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            record_latency(call, static_cast<std::uint64_t>(
+                                     std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+    }
+
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+private:
+    TimedCall call;
+    std::chrono::steady_clock::time_point start {};
+};
+} // namespace The_Deck::detail
+#endif
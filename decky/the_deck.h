@@ -11,15 +11,23 @@
 #endif
 
 #include <algorithm>
+#include <array>
+#include <compare>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <mutex>
 #include <numeric>
+#include <optional>
 #include <random>
 #include <ranges>
 #include <span>
 #include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 namespace The_Deck {
@@ -32,6 +40,17 @@ namespace The_Deck {
 enum class DLL_API Opmode { ENCRYPT = 0,
     DECRYPT };
 
+/** How the result of a crypt should be laid out: in the traditional groups
+ * of five letters, eight groups to a line; as the bare letters; or as the
+ * bare letter values, 1 for A through 26 for Z, one per byte.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+enum class DLL_API OutputFormat { GROUPED = 0,
+    LETTERS,
+    VALUES };
+
 /** A convenience class that encapsulates typesafe information about
  * a card’s rank and suit. It also supports ordering and comparison
  * operations.
@@ -153,6 +172,294 @@ struct DLL_API Card {
  */
 DLL_API std::ostream& operator<<(std::ostream& stream, const Card& card);
 
+/** A card packed into a single byte holding its ordinal: 0-51 for the
+ * ordinary cards in Card(int32_t) order, then 52 for joker A and 53 for
+ * joker B. Suit, rank, value and ordering all come out of small constexpr
+ * tables, so a full deck packs into fifty-four bytes and comparing two
+ * cards is a pair of loads. It converts to and from Card freely.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+class DLL_API PackedCard {
+public:
+    static constexpr uint8_t JOKER_A = 52;
+    static constexpr uint8_t JOKER_B = 53;
+    static constexpr uint8_t COUNT = 54;
+
+    /** Creates the ace of clubs, ordinal zero.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr PackedCard() = default;
+
+    /** Creates the card with the given ordinal.
+     *
+     * @throws std::range_error if the ordinal is outside the range
+     * (0, 53) inclusive.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    explicit constexpr PackedCard(const uint8_t ordinal)
+        : packed { ordinal }
+    {
+        if (ordinal >= COUNT)
+            throw std::range_error("PackedCard ordinal must be in the range of 0-53");
+    }
+
+    /** Packs a Card.
+     *
+     * @throws std::invalid_argument if the card isn’t one of the standard
+     * fifty-four.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    explicit PackedCard(const Card& card);
+
+    /** Unpacks the card.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    operator Card() const { return Card(suit(), rank()); }
+
+    [[nodiscard]] constexpr uint8_t ordinal() const { return packed; }
+    [[nodiscard]] constexpr Card::Suit suit() const { return SUITS[packed]; }
+    [[nodiscard]] constexpr Card::Rank rank() const { return RANKS[packed]; }
+
+    /** Returns the value Solitaire counts with: 1-52 for the ordinary
+     * cards and 53 for either joker.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] constexpr uint8_t value() const { return VALUES[packed]; }
+
+    /** Returns the same number Card::card_as_int would: 0-51 for the
+     * ordinary cards and 52 for either joker.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] constexpr int32_t as_int() const { return VALUES[packed] - 1; }
+
+    /** Orders cards just as Card::operator< does: joker A, then joker B,
+     * then the ordinary cards.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr bool operator<(const PackedCard other) const
+    {
+        return ORDER[packed] < ORDER[other.packed];
+    }
+
+    constexpr bool operator==(const PackedCard& other) const = default;
+
+private:
+    uint8_t packed { 0 };
+
+    static constexpr auto SUITS = [] {
+        std::array<Card::Suit, COUNT> table {};
+        for (uint8_t i = 0; i < COUNT; i++)
+            table[i] = i < JOKER_A ? static_cast<Card::Suit>(i / 13) : Card::Suit::NONE;
+        return table;
+    }();
+    static constexpr auto RANKS = [] {
+        std::array<Card::Rank, COUNT> table {};
+        for (uint8_t i = 0; i < COUNT; i++)
+            table[i] = i < JOKER_A ? static_cast<Card::Rank>(i % 13)
+                : i == JOKER_A     ? Card::Rank::JOKER_A
+                                   : Card::Rank::JOKER_B;
+        return table;
+    }();
+    static constexpr auto VALUES = [] {
+        std::array<uint8_t, COUNT> table {};
+        for (uint8_t i = 0; i < COUNT; i++)
+            table[i] = static_cast<uint8_t>(std::min<uint8_t>(i, JOKER_A) + 1);
+        return table;
+    }();
+    static constexpr auto ORDER = [] {
+        std::array<uint8_t, COUNT> table {};
+        for (uint8_t i = 0; i < COUNT; i++)
+            table[i] = static_cast<uint8_t>(i < JOKER_A ? i + 2 : i - JOKER_A);
+        return table;
+    }();
+};
+
+/** A contiguous sequence container with a fixed, compile-time capacity.
+ * It offers the subset of std::vector’s interface the library needs, but
+ * keeps its elements inline and never touches the heap. Since it’s
+ * trivially copyable, copying one is a plain memcpy.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+template <typename T, std::size_t Capacity>
+class FixedVector {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    std::array<T, Capacity> items {};
+    std::size_t count { 0 };
+
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using iterator = T*;
+    using const_iterator = const T*;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    FixedVector() = default;
+
+    template <std::input_iterator I>
+    FixedVector(I first, I last)
+    {
+        insert(cend(), first, last);
+    }
+
+    static constexpr size_type capacity() { return Capacity; }
+    static constexpr size_type max_size() { return Capacity; }
+    size_type size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    T* data() { return items.data(); }
+    const T* data() const { return items.data(); }
+
+    iterator begin() { return items.data(); }
+    iterator end() { return items.data() + count; }
+    const_iterator begin() const { return items.data(); }
+    const_iterator end() const { return items.data() + count; }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+    const_reverse_iterator crbegin() const { return rbegin(); }
+    const_reverse_iterator crend() const { return rend(); }
+
+    T& operator[](size_type index) { return items[index]; }
+    const T& operator[](size_type index) const { return items[index]; }
+    T& front() { return items[0]; }
+    const T& front() const { return items[0]; }
+    T& back() { return items[count - 1]; }
+    const T& back() const { return items[count - 1]; }
+
+    /** @throws std::out_of_range if a bounds violation occurs. */
+    T& at(size_type index)
+    {
+        if (index >= count)
+            throw std::out_of_range("FixedVector::at: index is out of range");
+        return items[index];
+    }
+
+    /** @throws std::out_of_range if a bounds violation occurs. */
+    const T& at(size_type index) const
+    {
+        if (index >= count)
+            throw std::out_of_range("FixedVector::at: index is out of range");
+        return items[index];
+    }
+
+    void clear() { count = 0; }
+
+    /** @throws std::length_error if the container is already full. */
+    void push_back(const T& item)
+    {
+        if (count == Capacity)
+            throw std::length_error("FixedVector::push_back: capacity exceeded");
+        items[count++] = item;
+    }
+
+    void pop_back() { count -= 1; }
+
+    /** @throws std::length_error if the container is already full. */
+    iterator insert(const_iterator position, const T& item)
+    {
+        if (count == Capacity)
+            throw std::length_error("FixedVector::insert: capacity exceeded");
+        const auto where = begin() + (position - cbegin());
+        std::copy_backward(where, end(), end() + 1);
+        *where = item;
+        count += 1;
+        return where;
+    }
+
+    /** @throws std::length_error if the insertion would exceed the capacity. */
+    template <std::input_iterator I>
+    iterator insert(const_iterator position, I first, I last)
+    {
+        const auto offset = position - cbegin();
+        auto where = begin() + offset;
+        for (; first != last; ++first)
+            where = insert(where, *first) + 1;
+        return begin() + offset;
+    }
+
+    iterator erase(const_iterator position)
+    {
+        return erase(position, position + 1);
+    }
+
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        const auto where = begin() + (first - cbegin());
+        const auto new_end = std::copy(begin() + (last - cbegin()), end(), where);
+        count = static_cast<size_type>(new_end - begin());
+        return where;
+    }
+
+    bool operator==(const FixedVector& other) const
+    {
+        return std::ranges::equal(*this, other);
+    }
+};
+
+/** A deck’s canonical compact form: how many cards it holds, and their
+ * order as a Lehmer code. Each card is numbered by where it stands among
+ * the cards not yet placed, and those numbers are packed into one
+ * mixed-radix number, which for any arrangement of up to fifty-four cards
+ * fits in thirty bytes. Two decks have the same code exactly when they’re
+ * equal, so codes can be stored, compared, sorted and hashed in place of
+ * the decks themselves.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+struct DLL_API DeckCode {
+    /** How many bytes the Lehmer code takes. */
+    static constexpr std::size_t SIZE = 30;
+
+    /** How many cards the deck holds. */
+    uint8_t cards { 0 };
+
+    /** The Lehmer code, least significant byte first. */
+    std::array<uint8_t, SIZE> lehmer {};
+
+    bool operator==(const DeckCode&) const = default;
+
+    /** Orders codes by how many cards they hold, then by the Lehmer code
+     * as a number, from its most significant byte down.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    std::strong_ordering operator<=>(const DeckCode& other) const
+    {
+        if (const auto order = cards <=> other.cards; order != 0)
+            return order;
+        return std::lexicographical_compare_three_way(lehmer.rbegin(), lehmer.rend(),
+            other.lehmer.rbegin(), other.lehmer.rend());
+    }
+};
+
 /** Represents a deck of cards and supports many standard deck operations.
  *
  * @since December 2024
@@ -160,50 +467,109 @@ DLL_API std::ostream& operator<<(std::ostream& stream, const Card& card);
  */
 struct DLL_API Deck {
 private:
-    inline static std::mt19937 gen { std::random_device {}() };
     static const Card JOKER_A;
     static const Card JOKER_B;
-    inline static std::mutex gen_mutex;
 
 public:
+    /** The most cards a deck can hold: fifty-two plus two jokers.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    static constexpr std::size_t MAX_CARDS = 54;
+
     /**  This is public to facilitate third parties (you) doing sneaky
      * stuff with the cards. Please don’t tamper with this part lightly,
      * as all manner of things can break.
      *
+     * The cards live inline in the Deck, so creating or copying a deck
+     * never allocates.
+     *
      * @since December 2024
      * @author Eugene Libster <elibster@gmail.com>
      */
-    std::vector<Card> deck;
+    FixedVector<Card, MAX_CARDS> deck;
 
     enum class Kind { WITHOUT_JOKERS = 0,
         WITH_JOKERS = 1 };
 
     explicit Deck(Kind k = Kind::WITHOUT_JOKERS)
     {
-        std::vector<int> zero_to_51(52);
-        std::iota(zero_to_51.begin(), zero_to_51.end(), 0);
-        std::ranges::transform(zero_to_51, std::back_inserter(deck),
-            [](const int x) { return Card(x); });
+        for (int32_t i = 0; i < 52; i++)
+            deck.push_back(Card(i));
         if (k == Kind::WITH_JOKERS) {
             deck.push_back(JOKER_A);
             deck.push_back(JOKER_B);
         }
+        reindex();
     }
 
     Deck(const Deck& other) = default;
+    Deck& operator=(const Deck& other) = default;
 
     /** Used to initialize a deck from any generic sequence of cards,
      * including arrays of them.
      *
+     * @throws std::length_error if the sequence holds more than MAX_CARDS
+     * cards.
      * @since December 2024
      * @author Eugene Libster <elibster@gmail.com>
      */
     explicit Deck(const std::span<const Card>& other_deck)
     {
-        deck.clear();
+        if (other_deck.size() > MAX_CARDS)
+            throw std::length_error("Deck: too many cards");
         std::ranges::copy(other_deck, std::back_inserter(deck));
+        reindex();
     }
 
+    /** Unpacks a deck from packed cards.
+     *
+     * @throws std::length_error if the sequence holds more than MAX_CARDS
+     * cards.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    explicit Deck(std::span<const PackedCard> packed_deck);
+
+    /** Returns the deck packed at one byte per card, for keeping many
+     * decks in little space.
+     *
+     * @throws std::invalid_argument if the deck holds a card that isn’t
+     * one of the standard fifty-four.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] FixedVector<PackedCard, MAX_CARDS> packed() const;
+
+    /** Rebuilds a deck from its canonical code.
+     *
+     * @throws std::invalid_argument if the code isn’t one that code()
+     * could have returned.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    explicit Deck(const DeckCode& code);
+
+    /** Returns the deck’s canonical code.
+     *
+     * @throws std::invalid_argument if the deck holds a card that isn’t
+     * one of the standard fifty-four, or holds a card twice.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] DeckCode code() const;
+
+    /** Returns a 64-bit hash of the deck’s cards, in order. It mixes
+     * well enough for hash tables and deduplicating huge numbers of
+     * decks, but it isn’t a cryptographic hash. Equal decks always hash
+     * the same.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] uint64_t hash() const noexcept;
+
     /** Used to do a bounds-checked peek into a deck. Useful for debugging,
      * and also shenanigans.
      *
@@ -230,7 +596,10 @@ public:
     bool operator==(const Deck& other) const;
 
     /** Performs a high quality <b>but not cryptologically secure</b>
-     * shuffle on the cards using the Mersenne Twister algorithm.
+     * shuffle on the cards using the Mersenne Twister algorithm. Each
+     * thread has its own generator, seeded from std::random_device the
+     * first time that thread shuffles, so threads never wait on each
+     * other here.
      *
      * @since December 2024
      * @author Eugene Libster <elibster@gmail.com>
@@ -238,6 +607,21 @@ public:
      */
     void shuffle();
 
+    /** Shuffles the cards with a caller-supplied random number generator,
+     * for callers who want a particular (or a reproducible) source of
+     * randomness. It’s only as good as the generator it’s given.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    template <typename G>
+        requires std::uniform_random_bit_generator<std::remove_reference_t<G>>
+    void shuffle(G&& generator)
+    {
+        std::ranges::shuffle(deck, generator);
+        reindex();
+    }
+
     /** Sorts the deck according to the cards’ underlying comparison operator.
      *
      * @since December 2024
@@ -257,6 +641,8 @@ public:
     /** Inserts a card anywhere in the deck. Useful for shenanigans, and
      * extremely useful for implementing Solitaire.
      *
+     * @throws std::out_of_range if a bounds violation occurs.
+     * @throws std::length_error if the deck already holds MAX_CARDS cards.
      * @bug Attempting to access a nonexistent position just adds the card
      * to the end of the deck instead of throwing a std::range_error.
      * @since December 2024
@@ -278,7 +664,8 @@ public:
      */
     void bury_1_with_wraparound(const Card& card);
 
-    /** Performs a Solitaire bury-N operation.
+    /** Performs a Solitaire bury-N operation. The card moves straight to
+     * its final position, rather than being buried one slot at a time.
      *
      * @since December 2024
      * @author Eugene Libster <elibster@gmail.com>
@@ -334,6 +721,7 @@ public:
         auto e = std::ranges::remove_if(
             deck, Pred); // Arranges the vector such that the things
         deck.erase(e.begin(), e.end());
+        reindex();
     }
 
     [[nodiscard]]
@@ -346,159 +734,1476 @@ public:
     {
         return deck.size();
     }
+
+private:
+    /** Maps each card to where it last was in the deck, so that finding
+     * a card (the jokers, especially) doesn’t take a linear scan. Since
+     * the deck itself is public this is only ever treated as a hint:
+     * every lookup is checked against the deck and the index is rebuilt
+     * if it has gone stale.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    std::array<uint8_t, MAX_CARDS> positions {};
+
+    /** Refreshes the position index for the cards in [first, last). */
+    void reindex(size_t first, size_t last);
+
+    /** Refreshes the position index for the whole deck. */
+    void reindex() { reindex(0, deck.size()); }
+
+    /** Returns the position of a card in the deck, or size() if the card
+     * isn’t present.
+     */
+    size_t locate(const Card& card);
+    /** Steps the deck in place, keeping the jokers’ entries in the index
+     * up to date as it goes.
+     */
+    friend DLL_API uint8_t get_raw_keystream_value(Deck& deck);
 };
 
-/** Returns the next Solitaire keystream value from the deck,
- * in a 1..N format.
+/** Generates Solitaire keystream from a private copy of a deck, much
+ * faster than stepping a Deck through its individual operations.
  *
- * @since December 2024
- * @author Eugene Libster <elibster@gmail.com>
- */
-DLL_API uint8_t get_raw_keystream_value(Deck& deck);
-
-/** Returns the next Solitaire keystream value from the deck,
- * in range (1, 26) inclusive.
+ * The cards are held as one-byte ordinals in a pair of buffers. Each
+ * step works out where the two buries leave the jokers and where the
+ * triple cut and count cut split the deck, then assembles the next deck
+ * state in the other buffer from a handful of block copies and swaps
+ * buffers. Nothing is searched for and nothing is shifted a card at a
+ * time.
  *
- * @since December 2024
- * @author Eugene Libster <elibster@gmail.com>
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
  */
-DLL_API uint8_t get_keystream_value(Deck& deck);
+class DLL_API KeystreamEngine {
+public:
+    /** Starts generating keystream from the given deck state.
+     *
+     * @throws std::logic_error if the deck doesn’t hold exactly one of
+     * each joker.
+     * @throws std::invalid_argument if the deck holds a card that isn’t
+     * one of the standard fifty-four.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    explicit KeystreamEngine(const Deck& deck);
 
-/** Converts a string into a sequence of integers ready for
- * Solitaire.
- *
- * @since December 2024
- * @author Eugene Libster <elibster@gmail.com>
- */
-DLL_API std::vector<uint8_t> convert_string_to_uint8(std::string input_string);
+    /** Performs one full round of Solitaire (both buries, the triple cut
+     * and the count cut) and returns the resulting keystream value,
+     * which may be the 53 that Solitaire discards.
+     *
+     * @throws std::out_of_range if the top card counts past the bottom
+     * of the deck, which can only happen with a short deck.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    uint8_t step();
 
-/** Converts a vector of integers into a string of characters.
- *
- * @bug We really should make this work on a std::span.
- * @since December 2024
- * @author Eugene Libster <elibster@gmail.com>
- */
-DLL_API std::string convert_uint8_to_string(std::span<const uint8_t> input_numbers);
+    /** Cuts the given number of cards off the top of the deck and puts
+     * them back just above the bottom card, as the count cut does, only
+     * by a number of the caller’s choosing. Passphrase keying does this
+     * once per letter. A cut of all but the bottom card or more leaves
+     * the deck as it is.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    void count_cut(size_t cards);
 
-/** Runs the Solitaire algorithm on a given string.
- *
- * @since December 2024
- * @author Eugene Libster <elibster@gmail.com>
- */
-DLL_API std::string crypt(const std::string& input, const Deck& deck, Opmode mode);
+    /** Returns the next Solitaire keystream value in a 1..N format,
+     * exactly as get_raw_keystream_value would.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    uint8_t next_raw();
 
-/** Runs the Solitaire encryption algorithm on a given string.
- *
- * @since December 2024
- * @author Eugene Libster <elibster@gmail.com>
- */
-DLL_API std::string encrypt(const std::string& plaintext, const Deck& deck);
+    /** Returns the next Solitaire keystream value in range (1, 26)
+     * inclusive, exactly as get_keystream_value would.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    uint8_t next();
 
-/** Runs the Solitaire decryption algorithm on a given string.
- *
- * @since December 2024
- * @author Eugene Libster <elibster@gmail.com>
- */
-DLL_API std::string decrypt(const std::string& ciphertext, const Deck& deck);
+    /** Returns the engine’s current deck state.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] Deck deck() const;
 
-/** Provides an STL-friendly interface to the Solitaire algorithm.
+    /** How many bytes the engine copies at a time. Each buffer carries
+     * this much slack past the end of the deck.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    static constexpr std::size_t OVERCOPY = 64;
+
+private:
+    std::array<std::array<uint8_t, Deck::MAX_CARDS + OVERCOPY>, 2> buffers {};
+    uint8_t current { 0 };
+    uint8_t count { 0 };
+    uint8_t joker_a { 0 };
+    uint8_t joker_b { 0 };
+};
+
+/** Fills caller-provided buffers with Solitaire keystream, many values
+ * per call. It owns its deck state, so successive calls carry on where
+ * the last one left off.
  *
- * @since January 2025
+ * @since October 2026
  * @author Rob Hansen <rob@hansen.engineering>
  */
-template <std::input_iterator T, std::output_iterator<uint8_t> U>
-void stl_crypt(T begin, T end, U output, const Deck& deck, Opmode mode)
-{
-    /* Compile-time sanity check */
-    static_assert(sizeof(decltype(*begin)) == 1);
+class DLL_API KeystreamGenerator {
+public:
+    /** Starts generating keystream from the given deck state.
+     *
+     * @throws std::logic_error if the deck doesn’t hold exactly one of
+     * each joker.
+     * @throws std::invalid_argument if the deck holds a card that isn’t
+     * one of the standard fifty-four.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    explicit KeystreamGenerator(const Deck& deck);
 
-    /* Runtime sanity checks */
-    if (end == begin)
-        return;
+    /** Fills the buffer with keystream values in a 1..N format, as
+     * get_raw_keystream_value would return them.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    void generate_raw(std::span<uint8_t> output);
 
-    Deck d(deck);
+    /** Fills the buffer with keystream values in range (1, 26) inclusive,
+     * as get_keystream_value would return them.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    void generate(std::span<uint8_t> output);
 
-    auto keystream = [&](uint8_t c) -> uint8_t {
-        auto deck_val = get_keystream_value(d);
-        if (mode == Opmode::ENCRYPT) {
-            uint8_t v = c + deck_val;
-            while (v > 26)
-                v -= 26;
-            return 'A' - 1 + v;
-        }
-        // Narrowing conversions from unsigned integers to signed ones are
-        // technically implementation-defined, except in the case where the
-        // values lie within the range of the narrowed type. That's the case
-        // here.
-        int8_t v = static_cast<int8_t>(c) - static_cast<int8_t>(deck_val);
-        while (v < 0)
-            v += 26;
-        return 'A' - 1 + v;
-    };
+    /** Returns the generator’s current deck state.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] Deck deck() const;
 
-    std::string working_copy { begin, end };
-    std::transform(working_copy.begin(), working_copy.end(), working_copy.begin(),
-        [](const auto& x) -> uint8_t { return ::toupper(x); });
-    auto filtered_working_copy = std::views::filter(working_copy,
-        [](const auto& x) { return (x >= 'A' && x <= 'Z'); });
-    std::string codesheet { filtered_working_copy.begin(), filtered_working_copy.end() };
-    while (codesheet.size() % 5)
-        codesheet += "X";
-    const auto result { convert_string_to_uint8(codesheet)
-        | std::views::transform(keystream) };
-    auto result_iter = result.begin();
-    uint32_t index { 0 };
-    while (result_iter != result.end()) {
-        if (index && (index % 40 == 0))
-            *output++ = '\n';
-        else if (index && (index % 5 == 0))
-            *output++ = ' ';
-        index += 1;
-        *output++ = *result_iter++;
-    }
-}
+private:
+    KeystreamEngine engine;
+};
 
-/** Provides another STL-friendly face for Solitaire.
+/** A Solitaire deck whose size is fixed at compile time: N - 2 ordinary
+ * cards and the two jokers, held as one-byte ordinals. The default is the
+ * standard fifty-four; smaller decks play by the same rules, scaled down,
+ * which makes them handy for studying the cipher at sizes where cycles
+ * and biases can be measured exhaustively.
  *
- * @since January 2025
- * @author Rob Hansen <rob@hansen.engineering>
- */
-template <std::input_iterator T, std::output_iterator<uint8_t> U>
-void solitaire(T begin, T end, U output, const Deck& deck, Opmode mode)
-{
-    stl_crypt(begin, end, output, deck, mode);
-}
-
-/** Provides another STL-friendly face for Solitaire.
+ * In a deck of N cards, ordinals 0 to N - 3 are the ordinary cards, with
+ * values 1 to N - 2, and ordinals N - 2 and N - 1 are jokers A and B, both
+ * with value N - 1. Every operation runs a fixed number of iterations and
+ * picks each card’s source with arithmetic and selects rather than
+ * branches, so for any given N the compiler can unroll it completely.
+ * Each size gets its own code; nothing here touches the heap.
  *
- * @since January 2025
+ * @since October 2026
  * @author Rob Hansen <rob@hansen.engineering>
  */
-DLL_API void solitaire(std::istream&& input, std::ostream& output, const Deck& deck,
-    Opmode mode);
+template <std::size_t N = Deck::MAX_CARDS>
+class SizedDeck {
+    static_assert(N >= 3 && N <= Deck::MAX_CARDS,
+        "a SizedDeck holds at least one ordinary card and at most fifty-four cards in all");
 
-/** Provides another STL-friendly face for Solitaire.
- *
- * @since January 2025
- * @author Rob Hansen <rob@hansen.engineering>
- */
-DLL_API void solitaire(std::istream& input, std::ostream& output, const Deck& deck,
-    Opmode mode);
+public:
+    /** The number of cards, jokers included. */
+    static constexpr std::size_t SIZE = N;
+    /** Joker A’s ordinal. */
+    static constexpr uint8_t JOKER_A = N - 2;
+    /** Joker B’s ordinal. */
+    static constexpr uint8_t JOKER_B = N - 1;
 
-/** Provides another STL-friendly face for Solitaire.
- *
- * @since January 2025
- * @author Rob Hansen <rob@hansen.engineering>
- */
-DLL_API void solitaire(std::istream&& input, std::ostream&& output, const Deck& deck,
-    Opmode mode);
+    /** Returns the value Solitaire counts with for an ordinal: one more
+     * than the ordinal for an ordinary card, and N - 1 for either joker.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    static constexpr uint8_t value(const uint8_t ordinal)
+    {
+        return static_cast<uint8_t>(std::min<uint8_t>(ordinal, N - 2) + 1);
+    }
 
-/** Provides another STL-friendly face for Solitaire.
- *
- * @since January 2025
- * @author Rob Hansen <rob@hansen.engineering>
- */
-DLL_API void solitaire(std::istream& input, std::ostream&& output, const Deck& deck,
+    /** Creates a deck in order: the ordinary cards in ordinal order, then
+     * joker A and joker B.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr SizedDeck()
+    {
+        std::iota(cards.begin(), cards.end(), uint8_t { 0 });
+    }
+
+    /** Creates a deck from ordinals, top card first.
+     *
+     * @throws std::invalid_argument if the ordinals aren’t each of 0 to
+     * N - 1 exactly once.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    explicit constexpr SizedDeck(const std::array<uint8_t, N>& ordinals)
+        : cards { ordinals }
+    {
+        std::array<bool, N> seen {};
+        for (std::size_t i = 0; i < N; i++) {
+            if (cards[i] >= N || seen[cards[i]])
+                throw std::invalid_argument("SizedDeck: the ordinals aren’t a permutation of the deck");
+            seen[cards[i]] = true;
+        }
+        locate_jokers();
+    }
+
+    /** Creates a standard-size deck from a Deck.
+     *
+     * @throws std::invalid_argument if the deck isn’t a full deck of
+     * fifty-four distinct cards.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    explicit SizedDeck(const Deck& deck)
+        requires(N == Deck::MAX_CARDS)
+        : SizedDeck(ordinals_of(deck))
+    {
+    }
+
+    /** Returns this standard-size deck as a Deck.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] Deck deck() const
+        requires(N == Deck::MAX_CARDS)
+    {
+        FixedVector<PackedCard, N> packed;
+        for (const auto ordinal : cards)
+            packed.push_back(PackedCard(ordinal));
+        return Deck(std::span<const PackedCard>(packed.data(), packed.size()));
+    }
+
+    /** Shuffles the deck with the given uniform random bit generator.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    template <typename G>
+        requires std::uniform_random_bit_generator<std::remove_reference_t<G>>
+    void shuffle(G&& generator)
+    {
+        std::shuffle(cards.begin(), cards.end(), generator);
+        locate_jokers();
+    }
+
+    /** Returns the deck’s ordinals, top card first.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] constexpr const std::array<uint8_t, N>& ordinals() const { return cards; }
+
+    /** Moves joker A one card down, wrapping from the bottom to just
+     * below the top card.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr void bury_joker_a()
+    {
+        const auto to = buried(joker_a, 1);
+        joker_b = displaced(joker_b, joker_a, to);
+        move(joker_a, to, JOKER_A);
+        joker_a = to;
+    }
+
+    /** Moves joker B two cards down, wrapping as bury_joker_a does.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr void bury_joker_b()
+    {
+        const auto to = buried(joker_b, 2);
+        joker_a = displaced(joker_a, joker_b, to);
+        move(joker_b, to, JOKER_B);
+        joker_b = to;
+    }
+
+    /** Swaps the cards above the top joker with those below the bottom
+     * joker.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr void triple_cut()
+    {
+        const auto low = std::min(joker_a, joker_b);
+        const auto high = std::max(joker_a, joker_b);
+        const std::size_t below = N - 1 - high;
+        const std::size_t middle = high - low + 1;
+        const auto source = cards;
+        for (std::size_t i = 0; i < N; i++) {
+            const auto from = i < below ? high + 1 + i
+                : i < below + middle    ? low + i - below
+                                        : i - below - middle;
+            cards[i] = source[from];
+        }
+        joker_a = static_cast<uint8_t>(joker_a - low + below);
+        joker_b = static_cast<uint8_t>(joker_b - low + below);
+    }
+
+    /** Cuts as many cards off the top as the bottom card’s value and puts
+     * them back just above the bottom card.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr void count_cut() { count_cut(value(cards[N - 1])); }
+
+    /** Cuts the given number of cards off the top and puts them back just
+     * above the bottom card. A cut of N - 1 cards or more leaves the deck
+     * as it is.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr void count_cut(const std::size_t count)
+    {
+        const auto cut = std::min(count, N - 1);
+        const auto source = cards;
+        for (std::size_t i = 0; i < N - 1; i++)
+            cards[i] = source[i + cut < N - 1 ? i + cut : i + cut - (N - 1)];
+        joker_a = cut_position(joker_a, cut);
+        joker_b = cut_position(joker_b, cut);
+    }
+
+    /** Performs one full round of Solitaire and returns the resulting
+     * keystream value, which is N - 1 when a joker comes up. This does
+     * what the four operations do in turn, but in one pass over the deck.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr uint8_t step()
+    {
+        // Where the buries leave the jokers. Neither bury changes the
+        // order of the ordinary cards.
+        const auto a_buried = buried(joker_a, 1);
+        const auto b_moved = displaced(joker_b, joker_a, a_buried);
+        const auto b_buried = buried(b_moved, 2);
+        const auto a_final = displaced(a_buried, b_moved, b_buried);
+        const auto low = std::min(a_final, b_buried);
+        const auto high = std::max(a_final, b_buried);
+
+        // The ordinary cards in order, with the jokers taken out. The
+        // working buffers have N cards of slack for copy_block.
+        std::array<uint8_t, N + N> source;
+        std::array<uint8_t, N + N> others;
+        std::copy_n(cards.begin(), N, source.begin());
+        const auto old_low = std::min(joker_a, joker_b);
+        const auto old_high = std::max(joker_a, joker_b);
+        auto* next = copy_block(others.data(), source.data(), old_low);
+        next = copy_block(next, source.data() + old_low + 1, old_high - old_low - 1);
+        copy_block(next, source.data() + old_high + 1, N - 1 - old_high);
+
+        // After the triple cut, the deck is the cards below the jokers,
+        // the first joker, the cards between them, the second joker and
+        // the cards above them. It's laid out twice over, less its last
+        // card the first time, so that the count cut is one block copy.
+        const std::size_t above = low;
+        const std::size_t between = high - low - 1;
+        const std::size_t below = N - 1 - high;
+        const auto first_joker = a_final < b_buried ? JOKER_A : JOKER_B;
+        const auto second_joker = a_final < b_buried ? JOKER_B : JOKER_A;
+        std::array<uint8_t, 3 * N> doubled;
+        next = doubled.data();
+        for (std::size_t pass = 0; pass < 2; pass++) {
+            next = copy_block(next, others.data() + above + between, below);
+            *next++ = first_joker;
+            next = copy_block(next, others.data() + above, between);
+            *next++ = second_joker;
+            next = copy_block(next, others.data(), above) - (pass == 0);
+        }
+
+        // And the count cut by the value of the card at the bottom.
+        const auto last = doubled[2 * N - 2];
+        const auto cut = std::min<std::size_t>(value(last), N - 1);
+        copy_block(cards.data(), doubled.data() + cut, N - 1);
+        cards[N - 1] = last;
+
+        const auto first_at = cut_position(static_cast<uint8_t>(below), cut);
+        const auto second_at = cut_position(static_cast<uint8_t>(below + between + 1), cut);
+        joker_a = a_final < b_buried ? first_at : second_at;
+        joker_b = a_final < b_buried ? second_at : first_at;
+
+        return value(cards[value(cards[0])]);
+    }
+
+    /** Returns the next keystream value, 1 to N - 2, skipping the rounds
+     * that turn up a joker.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr uint8_t next_raw()
+    {
+        uint8_t result;
+        while ((result = step()) == N - 1)
+            ;
+        return result;
+    }
+
+    /** Returns the next keystream value reduced to the range (1, 26)
+     * inclusive. For the standard deck, that’s exactly what
+     * get_keystream_value returns.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr uint8_t next()
+    {
+        return static_cast<uint8_t>((next_raw() - 1) % 26 + 1);
+    }
+
+    /** Fills the buffer with keystream values from next_raw.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr void generate_raw(const std::span<uint8_t> output)
+    {
+        for (auto& out : output)
+            out = next_raw();
+    }
+
+    /** Fills the buffer with keystream values from next.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    constexpr void generate(const std::span<uint8_t> output)
+    {
+        for (auto& out : output)
+            out = next();
+    }
+
+    constexpr bool operator==(const SizedDeck& other) const { return cards == other.cards; }
+
+private:
+    std::array<uint8_t, N> cards {};
+    uint8_t joker_a { JOKER_A };
+    uint8_t joker_b { JOKER_B };
+
+    static std::array<uint8_t, N> ordinals_of(const Deck& deck)
+    {
+        if (deck.size() != N)
+            throw std::invalid_argument("SizedDeck: the deck isn’t a full deck");
+        const auto packed = deck.packed();
+        std::array<uint8_t, N> ordinals {};
+        for (std::size_t i = 0; i < N; i++)
+            ordinals[i] = packed[i].ordinal();
+        return ordinals;
+    }
+
+    constexpr void locate_jokers()
+    {
+        for (std::size_t i = 0; i < N; i++) {
+            joker_a = cards[i] == JOKER_A ? static_cast<uint8_t>(i) : joker_a;
+            joker_b = cards[i] == JOKER_B ? static_cast<uint8_t>(i) : joker_b;
+        }
+    }
+
+    // Where a card at `position` ends up moved `slots` down, treating the
+    // deck as a loop that skips the top position.
+    static constexpr uint8_t buried(const uint8_t position, const std::size_t slots)
+    {
+        return static_cast<uint8_t>(1 + (position + slots - 1) % (N - 1));
+    }
+
+    // Where the card at `position` ends up when another card moves from
+    // `from` to `to`.
+    static constexpr uint8_t displaced(const uint8_t position, const uint8_t from, const uint8_t to)
+    {
+        return static_cast<uint8_t>(position
+            - (from < position && position <= to)
+            + (to <= position && position < from));
+    }
+
+    // Where the card at `position` ends up after a count cut of `cut`.
+    static constexpr uint8_t cut_position(const uint8_t position, const std::size_t cut)
+    {
+        return static_cast<uint8_t>(position == N - 1 ? position
+                : position >= cut                     ? position - cut
+                                                      : position + (N - 1 - cut));
+    }
+
+    // Copies `length` cards from `in` to `out` and returns the end of the
+    // copy. At runtime it moves a whole N-card block, which compiles to a
+    // few fixed-width moves, so N cards must fit at both `in` and `out`.
+    static constexpr uint8_t* copy_block(uint8_t* out, const uint8_t* in, const std::size_t length)
+    {
+        if consteval {
+            std::copy_n(in, length, out);
+        } else {
+            std::memcpy(out, in, N);
+        }
+        return out + length;
+    }
+
+    // Moves the card at `from` to `to`, sliding the cards in between
+    // over by one.
+    constexpr void move(const uint8_t from, const uint8_t to, const uint8_t card)
+    {
+        const auto source = cards;
+        for (std::size_t i = 0; i < N; i++) {
+            const auto at = i + (from <= i && i < to) - (to < i && i <= from);
+            cards[i] = i == to ? card : source[at];
+        }
+    }
+};
+
+/** The shape of the path a deck takes under repeated rounds of
+ * Solitaire: the rounds it takes to reach a state it will come back to,
+ * and how many rounds it then takes to come back.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+struct DLL_API CycleLength {
+    /** Rounds before the deck first reaches its cycle. */
+    uint64_t tail { 0 };
+    /** Rounds around the cycle. */
+    uint64_t period { 0 };
+    /** Whether the cycle was found within the round limit; if not, tail
+     * and period are both zero. */
+    bool found { false };
+};
+
+/** Finds the tail and period of the sequence of deck states that full
+ * rounds of Solitaire (SizedDeck::step, jokers and all) take a deck
+ * through, using Brent’s algorithm. Memory use is three decks, however
+ * long the cycle is. It takes at most about three times the tail plus
+ * the period in rounds, and gives up after `max_rounds` rounds of its
+ * search for the period.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+template <std::size_t N>
+CycleLength find_cycle(const SizedDeck<N>& start, const uint64_t max_rounds)
+{
+    // Find the period: the hare runs ahead, and the tortoise teleports to
+    // it at every power of two until the hare laps it.
+    uint64_t power = 1;
+    uint64_t period = 1;
+    uint64_t rounds = 1;
+    auto tortoise = start;
+    auto hare = start;
+    hare.step();
+    while (!(tortoise == hare)) {
+        if (rounds >= max_rounds)
+            return {};
+        if (power == period) {
+            tortoise = hare;
+            power *= 2;
+            period = 0;
+        }
+        hare.step();
+        period += 1;
+        rounds += 1;
+    }
+
+    // Find the tail: with the hare a period ahead, step both until they
+    // meet at the start of the cycle.
+    tortoise = start;
+    hare = start;
+    for (uint64_t i = 0; i < period; i++)
+        hare.step();
+    uint64_t tail = 0;
+    while (!(tortoise == hare)) {
+        tortoise.step();
+        hare.step();
+        tail += 1;
+    }
+    return { tail, period, true };
+}
+
+/** Runs find_cycle on many decks of `cards` cards at once, spread across
+ * the library’s thread pool. The decks are given as ordinals (see
+ * SizedDeck), `cards` to a deck, one after another.
+ *
+ * @returns one result per deck, in order.
+ * @throws std::invalid_argument if `cards` isn’t from 3 to 54, the
+ * ordinals don’t divide into decks of that many, or a deck isn’t a
+ * permutation of 0 to cards - 1.
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API std::vector<CycleLength> find_cycles(size_t cards, std::span<const uint8_t> decks,
+    uint64_t max_rounds);
+
+/** Runs Solitaire on 8, 16 or 32 standard decks in lockstep, one deck per
+ * lane, for key search, statistics and other work that needs keystream
+ * from many decks at once. Each lane gives exactly the keystream a
+ * KeystreamGenerator (or get_keystream_value) would for its deck.
+ *
+ * The decks are kept as a struct of arrays turned inside out: for each
+ * card, its position in every lane, side by side. The card a round's
+ * triple cut leaves on the bottom is found a round ahead, so a round
+ * works out each card’s new position in one pass, with the same few
+ * compares, masks and adds across all the lanes at once. Finding the
+ * card at a given position is a masked sum down the cards, so there are
+ * no per-lane branches or gathers. Lanes that have all the keystream
+ * they need are masked off while the others catch up. The kernel is
+ * built for SSE2 and, where the processor has it, AVX2.
+ *
+ * A round costs much the same whatever the width, so throughput grows
+ * with the lanes. With AVX2, 8 lanes give about four fifths of what one
+ * KeystreamGenerator does, while 16 lanes give nearly twice as much and
+ * 32 about three times as much. Eight lanes are there for callers that
+ * have eight decks; for speed alone, use 32.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+template <std::size_t Lanes>
+class LaneEngine {
+    static_assert(Lanes == 8 || Lanes == 16 || Lanes == 32,
+        "a LaneEngine runs 8, 16 or 32 decks");
+
+public:
+    /** The number of decks run side by side. */
+    static constexpr std::size_t LANES = Lanes;
+
+    /** Starts generating keystream from the given decks, one per lane.
+     *
+     * @throws std::invalid_argument if there isn’t exactly one deck per
+     * lane, or a deck isn’t a full deck of the standard fifty-four cards.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    explicit LaneEngine(std::span<const Deck> decks);
+
+    /** Performs one full round of Solitaire in every lane and returns
+     * each lane’s keystream value, which may be the 53 that Solitaire
+     * discards.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    std::array<uint8_t, Lanes> step();
+
+    /** Fills the buffer with keystream in a 1..N format, the same number
+     * of values from every lane: the first size() / LANES values come
+     * from lane 0, the next from lane 1, and so on.
+     *
+     * @throws std::length_error if the buffer’s size isn’t a multiple of
+     * the number of lanes.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    void generate_raw(std::span<uint8_t> output);
+
+    /** As generate_raw, but with values in range (1, 26) inclusive.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    void generate(std::span<uint8_t> output);
+
+    /** Returns one lane’s current deck state.
+     *
+     * @throws std::out_of_range if there’s no such lane.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] Deck deck(std::size_t lane) const;
+
+private:
+    // positions[card][lane]: where each card is in each lane's deck.
+    alignas(32) std::array<std::array<uint8_t, Lanes>, Deck::MAX_CARDS> positions {};
+    // cuts[lane]: the next round's count cut in each lane's deck.
+    alignas(32) std::array<uint8_t, Lanes> cuts {};
+};
+
+extern template class DLL_API LaneEngine<8>;
+extern template class DLL_API LaneEngine<16>;
+extern template class DLL_API LaneEngine<32>;
+
+/** Checkpoints of a keystream: the deck state every `interval` letters
+ * from a starting deck. With an index in hand, any point in the keystream
+ * is at most `interval` steps away, so a long message can be worked on
+ * from many places at once, or picked up from the middle.
+ *
+ * The first checkpoint is the starting deck itself, so an index is every
+ * bit as secret as the key it was made from.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+class DLL_API KeystreamIndex {
+public:
+    /** Starts an index for the deck, holding just the starting point.
+     *
+     * @throws std::invalid_argument if the interval is zero or more than
+     * 2^32 - 1, or the deck holds a card that isn’t one of the standard
+     * fifty-four.
+     * @throws std::logic_error if the deck doesn’t hold exactly one of
+     * each joker.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    KeystreamIndex(const Deck& deck, size_t interval);
+
+    /** Adds checkpoints until the index covers the first `letters`
+     * keystream values.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    void extend(uint64_t letters);
+
+    /** Returns a generator whose next value is keystream value number
+     * `position`, counting from zero. That’s at most `interval` steps from
+     * a checkpoint if the index covers the position.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] KeystreamGenerator seek(uint64_t position) const;
+
+    /** Returns how many letters apart the checkpoints are.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] size_t interval() const { return every; }
+
+    /** Returns how many keystream values the index covers, i.e. the
+     * position just past the last checkpoint’s interval.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] uint64_t letters() const { return checkpoints() * every; }
+
+    /** Returns how many checkpoints the index holds.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] size_t checkpoints() const { return states.size() / cards; }
+
+    /** Writes the index out in a compact form for keeping alongside a
+     * file: a short header, then each checkpoint’s card order at one byte
+     * per card.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] std::vector<uint8_t> serialize() const;
+
+    /** Reads back an index written by serialize.
+     *
+     * @throws std::invalid_argument if the data isn’t a valid index.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    static KeystreamIndex deserialize(std::span<const uint8_t> data);
+
+private:
+    friend class SolitaireContext;
+
+    size_t every;
+    size_t cards;
+    std::vector<uint8_t> states;
+
+    KeystreamIndex(size_t interval, size_t cards);
+    void append(const Deck& deck);
+};
+
+namespace detail {
+    struct CachedKeystream;
+}
+
+/** Encrypts or decrypts a message that arrives a piece at a time. The
+ * context carries the deck state and the formatting position from one
+ * update to the next, and only pads the message out at finalize, so the
+ * pieces put together come out exactly as a one-shot call to crypt would
+ * have produced them.
+ *
+ * While the keystream cache is on, a context that isn’t recording
+ * checkpoints takes the start of its keystream from the cache, and
+ * carries on with its own generator past the end of what’s cached.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+class DLL_API SolitaireContext {
+public:
+    /** Starts a message keyed with the given deck state.
+     *
+     * @throws std::logic_error if the deck doesn’t hold exactly one of
+     * each joker.
+     * @throws std::invalid_argument if the deck holds a card that isn’t
+     * one of the standard fifty-four.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    SolitaireContext(const Deck& deck, Opmode mode,
+        OutputFormat format = OutputFormat::GROUPED);
+
+    /** Starts a message keyed with the given deck state, recording a
+     * checkpoint every `checkpoint_interval` letters as it goes.
+     *
+     * @throws std::invalid_argument if the interval is zero or more than
+     * 2^32 - 1.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    SolitaireContext(const Deck& deck, Opmode mode, size_t checkpoint_interval,
+        OutputFormat format = OutputFormat::GROUPED);
+
+    /** Runs the next piece of the message, appending its result to the
+     * output. Anything other than a letter is skipped, as always.
+     *
+     * @throws std::logic_error if the context has been finalized.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    void update(std::span<const char> input, std::string& output);
+
+    /** Pads the message out to a whole group of five and appends the
+     * padding’s result to the output. No more updates are allowed after
+     * this.
+     *
+     * @throws std::logic_error if the context has already been finalized.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    void finalize(std::string& output);
+
+    /** Returns how many letters have gone through the context so far.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] uint64_t letters() const { return count; }
+
+    /** Returns the checkpoints recorded so far, which cover every letter
+     * through the most recent multiple of the interval.
+     *
+     * @throws std::logic_error if the context isn’t recording checkpoints.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] const KeystreamIndex& checkpoints() const;
+
+private:
+    KeystreamGenerator generator;
+    Opmode mode;
+    OutputFormat format;
+    uint64_t count { 0 };
+    bool finalized { false };
+    std::vector<uint8_t> values;
+    std::vector<uint8_t> key;
+    std::optional<KeystreamIndex> index;
+    std::shared_ptr<detail::CachedKeystream> cached;
+    size_t cached_size { 0 };
+    bool cache_checked { false };
+
+    void emit(size_t size, std::string& output);
+};
+
+/** One message for crypt_batch: the text to run, the deck to key it with,
+ * which way to run it, and a buffer for the result. The buffer must hold
+ * at least crypt_output_bound(input.size()) characters; crypt_batch sets
+ * `written` to how many it used.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+struct DLL_API CryptJob {
+    std::span<const char> input;
+    Deck deck;
+    Opmode mode { Opmode::ENCRYPT };
+    std::span<char> output;
+    size_t written { 0 };
+};
+
+/** Returns the most characters that crypt can produce from an input of
+ * the given length: every byte a letter, padded out to a group of five,
+ * plus a space or newline between groups.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API size_t crypt_output_bound(size_t input_size);
+
+/** Runs many independent messages at once on the library’s thread pool.
+ * Each job’s output is exactly what crypt would return for it. Messages
+ * are spread across the threads up front, and threads that finish early
+ * take work from the ones that haven’t, so a few long messages don’t hold
+ * everything up. Batches from different threads take turns on the pool.
+ *
+ * @throws std::length_error, before any work is done, if a job’s output
+ * buffer is smaller than crypt_output_bound of its input.
+ * @throws whatever a job throws (for instance, std::logic_error for a
+ * deck without both jokers). The remaining jobs are abandoned, and their
+ * output is unspecified.
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void crypt_batch(std::span<CryptJob> jobs);
+
+/** Runs one long message from a keystream index, in segments of the
+ * index’s interval spread across the library’s thread pool. The output
+ * is exactly what crypt would return for the index’s starting deck. If
+ * the message runs past the end of the index, a copy of the index is
+ * extended first.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API std::string crypt_indexed(std::span<const char> input,
+    const KeystreamIndex& index, Opmode mode);
+
+/** Sets how many threads crypt_batch and crypt_indexed use, counting the
+ * calling thread. Zero (the default) means one per hardware thread.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void set_batch_threads(size_t threads);
+
+/** Returns how many threads crypt_batch and crypt_indexed use, counting
+ * the calling thread.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API size_t batch_threads();
+
+/** Keys a deck from a passphrase the way Schneier describes: starting
+ * from the deck in order with joker A and then joker B on the bottom,
+ * each letter of the passphrase gets one full round of Solitaire followed
+ * by an extra count cut by the letter’s value (A = 1 through Z = 26).
+ * Anything other than a letter is skipped and case doesn’t matter. It
+ * takes time linear in the length of the passphrase.
+ *
+ * If the key cache is on, recently used passphrases come straight back
+ * out of it.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API Deck key_deck(std::span<const char> passphrase);
+
+/** Turns on the key cache, or resizes it. While it’s on, key_deck
+ * remembers the decks for the most recently used passphrases. Changing
+ * the capacity empties the cache, and a capacity of zero (the default)
+ * turns it off.
+ *
+ * The passphrases themselves aren’t kept: entries are found by a keyed
+ * 128-bit digest of each passphrase’s letters. Bear in mind that the
+ * keyed decks are every bit as secret, and those are held in memory.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void set_key_cache_capacity(size_t passphrases);
+
+/** Returns how many passphrases the key cache can hold, or zero if the
+ * cache is off.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API size_t key_cache_capacity();
+
+/** How far a passphrase search has got, as handed to its progress
+ * callback.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+struct DLL_API SearchProgress {
+    /** Candidate passphrases tried so far. */
+    uint64_t candidates { 0 };
+    /** Of those, how many decrypt to the crib. */
+    uint64_t matches { 0 };
+    /** Time since the search started. */
+    double seconds { 0 };
+
+    /** Returns the average number of candidates tried per second. */
+    [[nodiscard]] double per_second() const
+    {
+        return seconds > 0 ? static_cast<double>(candidates) / seconds : 0;
+    }
+};
+
+/** Searches a word list for passphrases under which the ciphertext
+ * decrypts to a known crib, one candidate passphrase per line. A
+ * candidate matches if the first letters of its plaintext are the crib’s
+ * letters; as with key_deck, only letters count, in either case.
+ *
+ * The list is read a batch at a time and each batch is spread across the
+ * library’s thread pool. Every candidate is keyed straight into a
+ * keystream engine with nothing allocated, and dropped at the first
+ * keystream value that disagrees with the crib, so most cost only their
+ * keying and a letter or two. The progress callback, if there is one,
+ * runs on the calling thread after each batch.
+ *
+ * @returns the matching lines, in the order they appear in the list.
+ * @throws std::invalid_argument if the crib holds no letters, or more
+ * letters than the ciphertext.
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API std::vector<std::string> search_passphrases(std::istream& words,
+    std::span<const char> ciphertext, std::span<const char> crib,
+    const std::function<void(const SearchProgress&)>& progress = {});
+
+/** Returns the next Solitaire keystream value from the deck,
+ * in a 1..N format.
+ *
+ * @since December 2024
+ * @author Eugene Libster <elibster@gmail.com>
+ */
+DLL_API uint8_t get_raw_keystream_value(Deck& deck);
+
+/** Returns the next Solitaire keystream value from the deck,
+ * in range (1, 26) inclusive.
+ *
+ * @since December 2024
+ * @author Eugene Libster <elibster@gmail.com>
+ */
+DLL_API uint8_t get_keystream_value(Deck& deck);
+
+/** Turns on the keystream cache, or resizes it. While it’s on, the
+ * library remembers the keystream of the most recently used starting
+ * decks, so encrypting or decrypting another message under one of them
+ * doesn’t have to step the deck all over again. Cached keystream is
+ * extended as longer messages come along, up to `max_prefix` values per
+ * deck. Changing the capacity empties the cache, and a capacity of zero
+ * (the default) turns it off. crypt, encrypt, decrypt, the solitaire
+ * overloads and SolitaireContext all draw on it.
+ *
+ * Bear in mind that the cache holds keystream for your keys in memory.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void set_keystream_cache_capacity(size_t decks,
+    size_t max_prefix = 65536);
+
+/** Returns how many decks’ worth of keystream the cache can hold, or
+ * zero if the cache is off.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API size_t keystream_cache_capacity();
+
+/** Fills the buffer with the keystream for the given starting deck, in
+ * range (1, 26) inclusive. If the keystream cache is on, this uses (and
+ * fills) the cache. It’s safe to call from many threads at once.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void fill_keystream(const Deck& deck, std::span<uint8_t> output);
+
+/** Prepares text for Solitaire in a single pass: upper-cases ASCII
+ * letters, drops everything else and maps the letters to values in range
+ * (1, 26) inclusive. Unlike ::toupper it never consults the C locale.
+ * Large inputs are handled sixteen or thirty-two bytes at a time with
+ * SSE2 or AVX2 where the processor has them.
+ *
+ * @returns the number of values written to the output.
+ * @throws std::length_error if the output is smaller than the input.
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API size_t normalize_letters(std::span<const char> input,
+    std::span<uint8_t> output);
+
+/** Combines letter values with keystream values, producing the
+ * ciphertext (when encrypting) or plaintext (when decrypting) as the
+ * letters A-Z. Both inputs must be in range (1, 26) inclusive. The
+ * arithmetic is branch-free and runs sixteen or thirty-two letters at a
+ * time with SSE2 or AVX2 where the processor has them. The output may be
+ * the same buffer as the values.
+ *
+ * @throws std::length_error if the keystream or output is shorter than
+ * the values.
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void combine_keystream(std::span<const uint8_t> values,
+    std::span<const uint8_t> keystream, std::span<uint8_t> output,
+    Opmode mode);
+
+/** Counts of what the library has been doing, summed over every thread,
+ * as returned by stats_snapshot. Statistics are only collected when the
+ * library is built with them turned on (meson’s `stats` option); in
+ * other builds `enabled` is false and everything else is zero.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+struct DLL_API StatsSnapshot {
+    /** Call counts and a log-scale latency histogram for one kind of
+     * call. Bucket 0 counts calls that took no measurable time, and bucket
+     * i counts those that took from 2^(i-1) up to 2^i nanoseconds.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    struct Latency {
+        uint64_t calls { 0 };
+        uint64_t total_ns { 0 };
+        std::array<uint64_t, 64> buckets {};
+    };
+
+    bool enabled { false };
+
+    /** Rounds of Solitaire run, including those rejected below. */
+    uint64_t keystream_steps { 0 };
+
+    /** Rounds whose output was a joker (53) and so had to be run again. */
+    uint64_t joker_rejections { 0 };
+
+    /** Decks loaded into, or copied back out of, the keystream engine.
+     * Deck itself stays trivially copyable, so plain copies of it can’t
+     * be counted. */
+    uint64_t deck_copies { 0 };
+
+    /** Bytes of input taken, and of output produced, by crypt (and so by
+     * encrypt, decrypt and stl_crypt) and the solitaire overloads. */
+    uint64_t bytes_in { 0 };
+    uint64_t bytes_out { 0 };
+
+    /** Lookups in the keystream cache that found the deck already there,
+     * and that didn’t. Nothing is counted while the cache is off. */
+    uint64_t keystream_cache_hits { 0 };
+    uint64_t keystream_cache_misses { 0 };
+
+    /** Latencies of crypt calls by direction (encrypt, decrypt and
+     * stl_crypt all land here), and of the stream and span solitaire
+     * overloads. */
+    Latency encrypt;
+    Latency decrypt;
+    Latency solitaire;
+
+    /** Returns the snapshot as a JSON object, with each histogram as an
+     * array of its sixty-four buckets.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] std::string to_json() const;
+};
+
+/** Returns the statistics gathered so far, summed over every thread,
+ * including threads that have since exited. Counters are kept per thread
+ * and updated without locks, so a snapshot taken while other threads are
+ * busy is a close approximation rather than an exact instant.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API StatsSnapshot stats_snapshot();
+
+/** Sets all of the statistics back to zero.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void reset_stats();
+
+/** A chi-square statistic and its degrees of freedom.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+struct DLL_API ChiSquare {
+    double statistic { 0 };
+    size_t degrees_of_freedom { 0 };
+
+    /** Returns the statistic as an approximate standard normal score, by
+     * the Wilson–Hilferty transformation: near zero for a good fit, and
+     * large and positive for a bad one. Anything past three or four
+     * deserves a closer look.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] double z_score() const;
+};
+
+/** Histograms of the keystream (1 to 26, as get_keystream_value returns
+ * it) from many randomly shuffled decks, as filled by analyze_keystream.
+ * Deck number i is shuffled from the seed and i alone, so a run can be
+ * saved with serialize, picked up again with deserialize, and still give
+ * exactly the counts a single unbroken run would have.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+struct DLL_API KeystreamAnalysis {
+    /** How many repeat gaps are counted separately; longer gaps share
+     * the last bucket. */
+    static constexpr size_t GAP_BUCKETS = 64;
+
+    /** Chooses the decks. */
+    uint64_t seed { 0 };
+    /** Keystream values taken from each deck. */
+    uint64_t values_per_deck { 0 };
+    /** Decks analyzed so far. */
+    uint64_t decks { 0 };
+    /** Keystream values analyzed so far. */
+    uint64_t samples { 0 };
+
+    /** How often each value came up, A in element zero. */
+    std::array<uint64_t, 26> unigrams {};
+    /** How often each value followed each other, within a deck: element
+     * 26 * first + second. */
+    std::array<uint64_t, 26 * 26> bigrams {};
+    /** How far apart two appearances of the same value were, within a
+     * deck: element g - 1 for a gap of g, so element zero counts values
+     * immediately repeated. */
+    std::array<uint64_t, GAP_BUCKETS> gaps {};
+
+    /** Tests the unigrams against a uniform distribution.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] ChiSquare unigram_chi_square() const;
+
+    /** Tests the bigrams against a uniform distribution.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] ChiSquare bigram_chi_square() const;
+
+    /** Tests the repeat gaps against the distribution that independent,
+     * uniform values would give in runs of `values_per_deck`: geometric,
+     * but with fewer chances at a long gap than a short one.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] ChiSquare gap_chi_square() const;
+
+    /** Returns the analysis as bytes, for saving a checkpoint.
+     *
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] std::vector<uint8_t> serialize() const;
+
+    /** Reads back an analysis written by serialize.
+     *
+     * @throws std::invalid_argument if the data isn’t a serialized
+     * analysis.
+     * @since October 2026
+     * @author Rob Hansen <rob@hansen.engineering>
+     */
+    [[nodiscard]] static KeystreamAnalysis deserialize(std::span<const uint8_t> data);
+};
+
+/** Carries an analysis on until it covers `decks` decks, spreading the
+ * decks across the library’s thread pool. Threads count into histograms
+ * of their own, a batch of decks at a time, and only take a lock to merge
+ * them in at the end of each batch. The work is done in rounds; after
+ * each one, the analysis is up to date and is handed to the checkpoint
+ * callback, if there is one, on the calling thread.
+ *
+ * @throws std::invalid_argument if the analysis takes no values from
+ * each deck.
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void analyze_keystream(KeystreamAnalysis& analysis, uint64_t decks,
+    const std::function<void(const KeystreamAnalysis&)>& checkpoint = {});
+
+/** Converts a string into a sequence of integers ready for
+ * Solitaire.
+ *
+ * @since December 2024
+ * @author Eugene Libster <elibster@gmail.com>
+ */
+DLL_API std::vector<uint8_t> convert_string_to_uint8(std::string input_string);
+
+/** Converts a vector of integers into a string of characters.
+ *
+ * @bug We really should make this work on a std::span.
+ * @since December 2024
+ * @author Eugene Libster <elibster@gmail.com>
+ */
+DLL_API std::string convert_uint8_to_string(std::span<const uint8_t> input_numbers);
+
+/** Lays out letters the way Solitaire’s output traditionally is, as if
+ * the first of them were letter number `position` of the message: a space
+ * before each group of five but the first, except that every eighth group
+ * starts a new line instead. Whole groups and lines are written at a time,
+ * so a message can be formatted a piece at a time, or in pieces on
+ * different threads.
+ *
+ * @returns the number of characters written.
+ * @throws std::length_error if the output holds fewer than
+ * `letters.size() + letters.size() / 5 + 1` characters.
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API size_t format_groups(std::span<const uint8_t> letters, uint64_t position,
+    std::span<char> output);
+
+/** Runs the Solitaire algorithm on a given string.
+ *
+ * @since December 2024
+ * @author Eugene Libster <elibster@gmail.com>
+ */
+DLL_API std::string crypt(const std::string& input, const Deck& deck, Opmode mode,
+    OutputFormat format = OutputFormat::GROUPED);
+
+/** Runs the Solitaire encryption algorithm on a given string.
+ *
+ * @since December 2024
+ * @author Eugene Libster <elibster@gmail.com>
+ */
+DLL_API std::string encrypt(const std::string& plaintext, const Deck& deck);
+
+/** Runs the Solitaire decryption algorithm on a given string.
+ *
+ * @since December 2024
+ * @author Eugene Libster <elibster@gmail.com>
+ */
+DLL_API std::string decrypt(const std::string& ciphertext, const Deck& deck);
+
+/** Provides an STL-friendly interface to the Solitaire algorithm.
+ *
+ * @since January 2025
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+template <std::input_iterator T, std::output_iterator<uint8_t> U>
+void stl_crypt(T begin, T end, U output, const Deck& deck, Opmode mode)
+{
+    /* Compile-time sanity check */
+    static_assert(sizeof(decltype(*begin)) == 1);
+
+    /* Runtime sanity checks */
+    if (end == begin)
+        return;
+
+    const std::string working_copy { begin, end };
+    for (const auto ch : crypt(working_copy, deck, mode))
+        *output++ = ch;
+}
+
+/** Provides another STL-friendly face for Solitaire.
+ *
+ * @since January 2025
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+template <std::input_iterator T, std::output_iterator<uint8_t> U>
+void solitaire(T begin, T end, U output, const Deck& deck, Opmode mode)
+{
+    stl_crypt(begin, end, output, deck, mode);
+}
+
+/** Runs Solitaire over a contiguous block of text, such as a
+ * memory-mapped file, writing the result to the stream a chunk at a time.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void solitaire(std::span<const char> input, std::ostream& output,
+    const Deck& deck, Opmode mode);
+
+/** Provides another STL-friendly face for Solitaire. This and the other
+ * stream overloads work through the input in fixed-size chunks, so memory
+ * use stays bounded however large the input is, and output starts to
+ * appear before the input has all been read.
+ *
+ * @since January 2025
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void solitaire(std::istream&& input, std::ostream& output, const Deck& deck,
+    Opmode mode);
+
+/** Provides another STL-friendly face for Solitaire.
+ *
+ * @since January 2025
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void solitaire(std::istream& input, std::ostream& output, const Deck& deck,
+    Opmode mode);
+
+/** Provides another STL-friendly face for Solitaire.
+ *
+ * @since January 2025
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void solitaire(std::istream&& input, std::ostream&& output, const Deck& deck,
+    Opmode mode);
+
+/** Provides another STL-friendly face for Solitaire.
+ *
+ * @since January 2025
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+DLL_API void solitaire(std::istream& input, std::ostream&& output, const Deck& deck,
     Opmode mode);
 } // namespace The_Deck
+
+/** Hashes decks with Deck::hash, so they can go straight into unordered
+ * containers.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+template <>
+struct std::hash<The_Deck::Deck> {
+    std::size_t operator()(const The_Deck::Deck& deck) const noexcept
+    {
+        return static_cast<std::size_t>(deck.hash());
+    }
+};
+
+/** Hashes deck codes by folding their bytes together.
+ *
+ * @since October 2026
+ * @author Rob Hansen <rob@hansen.engineering>
+ */
+template <>
+struct std::hash<The_Deck::DeckCode> {
+    std::size_t operator()(const The_Deck::DeckCode& code) const noexcept
+    {
+        uint64_t hash = code.cards;
+        for (std::size_t i = 0; i < The_Deck::DeckCode::SIZE; i += 8) {
+            uint64_t word = 0;
+            for (std::size_t byte = i; byte < std::min(i + 8, The_Deck::DeckCode::SIZE); byte++)
+                word |= static_cast<uint64_t>(code.lehmer[byte]) << (8 * (byte - i));
+            hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+            hash ^= hash >> 32;
+        }
+        return static_cast<std::size_t>(hash);
+    }
+};
 #endif
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+using std::exception_ptr;
+using std::function;
+using std::lock_guard;
+using std::make_unique;
+using std::max;
+using std::mutex;
+using std::size_t;
+using std::unique_lock;
+
+namespace The_Deck::detail {
+ThreadPool::ThreadPool(const size_t threads)
+{
+    const auto count = max<size_t>(threads, 1);
+    for (size_t i = 0; i < count; i++)
+        shares.push_back(make_unique<Share>());
+    // Slot zero belongs to whichever thread calls parallel_for.
+    for (size_t slot = 1; slot < count; slot++)
+        workers.emplace_back([this, slot] { worker_loop(slot); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        const lock_guard<mutex> lock(state_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::parallel_for(const size_t count,
+    const function<void(size_t)>& body)
+{
+    if (count == 0)
+        return;
+
+    const lock_guard<mutex> run_lock(run_mutex);
+    const auto threads = shares.size();
+    for (size_t slot = 0; slot < threads; slot++) {
+        const lock_guard<mutex> lock(shares[slot]->lock);
+        shares[slot]->begin = count * slot / threads;
+        shares[slot]->end = count * (slot + 1) / threads;
+    }
+
+    {
+        const lock_guard<mutex> lock(state_mutex);
+        current_body = &body;
+        failed = false;
+        failure = nullptr;
+        running = workers.size();
+        generation += 1;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    exception_ptr error;
+    {
+        unique_lock<mutex> lock(state_mutex);
+        finished.wait(lock, [this] { return running == 0; });
+        current_body = nullptr;
+        error = failure;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void ThreadPool::worker_loop(const size_t slot)
+{
+    size_t seen = 0;
+    for (;;) {
+        {
+            unique_lock<mutex> lock(state_mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        work(slot);
+        {
+            const lock_guard<mutex> lock(state_mutex);
+            running -= 1;
+        }
+        finished.notify_one();
+    }
+}
+
+void ThreadPool::work(const size_t slot)
+{
+    size_t index = 0;
+    while (!failed && take(slot, index)) {
+        try {
+            (*current_body)(index);
+        } catch (...) {
+            const lock_guard<mutex> lock(state_mutex);
+            if (!failure)
+                failure = std::current_exception();
+            failed = true;
+        }
+    }
+}
+
+// Takes the next index from this thread's own share, or failing that
+// steals the back half of another thread's.
+bool ThreadPool::take(const size_t slot, size_t& index)
+{
+    auto& own = *shares[slot];
+    {
+        const lock_guard<mutex> lock(own.lock);
+        if (own.begin < own.end) {
+            index = own.begin++;
+            return true;
+        }
+    }
+
+    const auto threads = shares.size();
+    for (size_t offset = 1; offset < threads; offset++) {
+        auto& victim = *shares[(slot + offset) % threads];
+        size_t begin = 0;
+        size_t end = 0;
+        {
+            const lock_guard<mutex> lock(victim.lock);
+            if (victim.begin >= victim.end)
+                continue;
+            const auto middle = victim.begin + (victim.end - victim.begin) / 2;
+            begin = middle;
+            end = victim.end;
+            victim.end = middle;
+        }
+        // Only this thread steals into its own share, and it's empty, so
+        // nobody else can have touched it in the meantime except to find
+        // it empty.
+        const lock_guard<mutex> lock(own.lock);
+        index = begin;
+        own.begin = begin + 1;
+        own.end = end;
+        return true;
+    }
+    return false;
+}
+} // namespace The_Deck::detail
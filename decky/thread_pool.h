@@ -0,0 +1,72 @@
+#ifndef DECKY_THREAD_POOL_H
+#define DECKY_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A library-internal, work-stealing thread pool for data-parallel loops.
+ * Each thread starts on its own share of the index range and works
+ * through it from the front; a thread that runs dry steals the back half
+ * of whichever other share it finds work in first, so uneven jobs even
+ * themselves out without a shared queue to fight over. */
+
+namespace The_Deck::detail {
+class ThreadPool {
+public:
+    /* Starts a pool that runs loops on `threads` threads in all, counting
+     * the thread that calls parallel_for. */
+    explicit ThreadPool(std::size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t size() const { return shares.size(); }
+
+    /* Calls body(i) for every i in [0, count) and returns once they've all
+     * finished. If any call throws, the rest are abandoned as soon as
+     * possible and the first exception is rethrown here. Loops from
+     * different callers take turns. */
+    void parallel_for(std::size_t count,
+        const std::function<void(std::size_t)>& body);
+
+private:
+    // One thread's remaining share of the loop, [begin, end).
+    struct alignas(64) Share {
+        std::mutex lock;
+        std::size_t begin { 0 };
+        std::size_t end { 0 };
+    };
+
+    std::vector<std::unique_ptr<Share>> shares;
+    std::vector<std::thread> workers;
+
+    std::mutex run_mutex; // one loop at a time
+    std::mutex state_mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(std::size_t)>* current_body { nullptr };
+    std::size_t generation { 0 };
+    std::size_t running { 0 };
+    bool stopping { false };
+    std::atomic<bool> failed { false };
+    std::exception_ptr failure;
+
+    void worker_loop(std::size_t slot);
+    void work(std::size_t slot);
+    bool take(std::size_t slot, std::size_t& index);
+};
+
+/* The pool behind the library's parallel entry points, sized by
+ * set_batch_threads and started on first use. Holding the pointer keeps
+ * the pool alive even if the thread count changes in the meantime. */
+std::shared_ptr<ThreadPool> shared_pool();
+} // namespace The_Deck::detail
+#endif
@@ -0,0 +1,128 @@
+#include "../decky/the_deck.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using std::cerr;
+using std::ifstream;
+using std::istreambuf_iterator;
+using std::ofstream;
+using std::string;
+using std::vector;
+using The_Deck::ChiSquare;
+using The_Deck::KeystreamAnalysis;
+
+/* Measures keystream bias over many randomly shuffled decks:
+ *
+ *     sol-analyze CHECKPOINT DECKS [VALUES_PER_DECK [SEED]]
+ *
+ * The analysis is saved to CHECKPOINT every half minute and at the end.
+ * If CHECKPOINT already exists, the run picks up where it left off, with
+ * the values per deck and seed it started with, and carries on until it
+ * has covered DECKS decks; giving a different VALUES_PER_DECK or SEED is
+ * an error. The chi-square statistics go to standard output; progress
+ * goes to standard error. */
+
+namespace {
+constexpr auto CHECKPOINT_EVERY = std::chrono::seconds(30);
+
+bool save(const KeystreamAnalysis& analysis, const string& path)
+{
+    // Write to the side and rename, so a crash never leaves a torn file.
+    const auto data = analysis.serialize();
+    const auto temporary = path + ".tmp";
+    {
+        ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file.flush())
+            return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+void report(const char* name, const ChiSquare& test)
+{
+    std::printf("%-8s chi-square %14.2f on %4zu degrees of freedom, z = %7.2f\n",
+        name, test.statistic, test.degrees_of_freedom, test.z_score());
+}
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || argc > 5) {
+        cerr << "usage: " << argv[0] << " CHECKPOINT DECKS [VALUES_PER_DECK [SEED]]\n";
+        return 2;
+    }
+    const string path(argv[1]);
+    KeystreamAnalysis analysis;
+    try {
+        const auto decks = std::stoull(argv[2]);
+        if (ifstream file { path, std::ios::binary }) {
+            const vector<uint8_t> data { istreambuf_iterator<char>(file), istreambuf_iterator<char>() };
+            analysis = KeystreamAnalysis::deserialize(data);
+            // Resuming with other settings would mix two analyses.
+            if (argc > 3 && std::stoull(argv[3]) != analysis.values_per_deck)
+                throw std::invalid_argument(path + " was started with "
+                    + std::to_string(analysis.values_per_deck) + " values per deck");
+            if (argc > 4 && std::stoull(argv[4]) != analysis.seed)
+                throw std::invalid_argument(path + " was started with seed "
+                    + std::to_string(analysis.seed));
+            cerr << "resuming after " << analysis.decks << " decks\n";
+        } else {
+            analysis.values_per_deck = argc > 3 ? std::stoull(argv[3]) : 1 << 20;
+            analysis.seed = argc > 4 ? std::stoull(argv[4]) : std::random_device {}();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto already = analysis.samples;
+        auto saved = start;
+        The_Deck::analyze_keystream(analysis, decks, [&](const KeystreamAnalysis& progress) {
+            const auto now = std::chrono::steady_clock::now();
+            const auto seconds = std::chrono::duration<double>(now - start).count();
+            char line[128];
+            std::snprintf(line, sizeof line, "\r%llu decks, %llu values, %.3g values per second",
+                static_cast<unsigned long long>(progress.decks),
+                static_cast<unsigned long long>(progress.samples),
+                static_cast<double>(progress.samples - already) / seconds);
+            cerr << line << std::flush;
+            if (now - saved >= CHECKPOINT_EVERY && save(progress, path))
+                saved = now;
+        });
+        cerr << "\n";
+        if (!save(analysis, path)) {
+            cerr << argv[0] << ": can't write " << path << "\n";
+            return 1;
+        }
+    } catch (const std::exception& error) {
+        cerr << argv[0] << ": " << error.what() << "\n";
+        return 1;
+    }
+
+    std::printf("%llu values from %llu decks (seed %llu, %llu values each)\n",
+        static_cast<unsigned long long>(analysis.samples),
+        static_cast<unsigned long long>(analysis.decks),
+        static_cast<unsigned long long>(analysis.seed),
+        static_cast<unsigned long long>(analysis.values_per_deck));
+    report("unigram", analysis.unigram_chi_square());
+    report("bigram", analysis.bigram_chi_square());
+    report("gap", analysis.gap_chi_square());
+
+    // Solitaire's best-known bias is in how often a value repeats
+    // straight away.
+    const auto repeats = static_cast<double>(analysis.gaps[0]);
+    std::uint64_t gaps = 0;
+    for (const auto count : analysis.gaps)
+        gaps += count;
+    if (gaps > 0)
+        std::printf("immediate repeats: %.6f of gaps (1/26 = %.6f)\n",
+            repeats / static_cast<double>(gaps), 1.0 / 26);
+    return 0;
+}
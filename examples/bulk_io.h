@@ -0,0 +1,201 @@
+#ifndef DECKY_EXAMPLES_BULK_IO_H
+#define DECKY_EXAMPLES_BULK_IO_H
+
+#include "../decky/the_deck.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Bulk I/O shared by sol-encrypt and sol-decrypt. Regular files are
+ * memory-mapped and handed to the library as a single span; pipes and
+ * terminals are read and written through large buffers straight to and
+ * from their file descriptors, so there's no per-byte stream overhead
+ * anywhere on the way through. */
+
+namespace Bulk_IO {
+constexpr size_t BUFFER_SIZE = 1 << 20;
+
+#ifndef _WIN32
+/* A stream buffer that reads its file descriptor a megabyte at a time.
+ * A failed read ends the input like end of file does, so the caller has
+ * to check read_error() to tell the two apart. */
+class FdInbuf : public std::streambuf {
+public:
+    explicit FdInbuf(const int fd)
+        : fd { fd }
+    {
+    }
+
+    /* The errno of the read that failed, or zero if none has. */
+    int read_error() const { return error; }
+
+protected:
+    int_type underflow() override
+    {
+        ssize_t got;
+        do
+            got = ::read(fd, buffer.data(), buffer.size());
+        while (got < 0 && errno == EINTR);
+        if (got < 0)
+            error = errno;
+        if (got <= 0)
+            return traits_type::eof();
+        setg(buffer.data(), buffer.data(), buffer.data() + got);
+        return traits_type::to_int_type(buffer[0]);
+    }
+
+private:
+    const int fd;
+    int error { 0 };
+    std::vector<char> buffer = std::vector<char>(BUFFER_SIZE);
+};
+
+/* A stream buffer that writes to its file descriptor a megabyte at a time,
+ * and hands anything larger than that straight to write(). */
+class FdOutbuf : public std::streambuf {
+public:
+    explicit FdOutbuf(const int fd)
+        : fd { fd }
+    {
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+
+    ~FdOutbuf() override { sync(); }
+
+protected:
+    int_type overflow(const int_type ch) override
+    {
+        if (sync() != 0)
+            return traits_type::eof();
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+            sputc(traits_type::to_char_type(ch));
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* data, const std::streamsize size) override
+    {
+        if (size < epptr() - pptr()) {
+            std::memcpy(pptr(), data, static_cast<size_t>(size));
+            pbump(static_cast<int>(size));
+            return size;
+        }
+        if (sync() != 0 || !write_all(data, static_cast<size_t>(size)))
+            return 0;
+        return size;
+    }
+
+    int sync() override
+    {
+        const auto pending = static_cast<size_t>(pptr() - pbase());
+        const auto ok = write_all(pbase(), pending);
+        setp(buffer.data(), buffer.data() + buffer.size());
+        return ok ? 0 : -1;
+    }
+
+private:
+    const int fd;
+    std::vector<char> buffer = std::vector<char>(BUFFER_SIZE);
+
+    bool write_all(const char* data, size_t size)
+    {
+        while (size > 0) {
+            const auto put = ::write(fd, data, size);
+            if (put < 0 && errno == EINTR)
+                continue;
+            if (put <= 0)
+                return false;
+            data += put;
+            size -= static_cast<size_t>(put);
+        }
+        return true;
+    }
+};
+
+/* Runs Solitaire over the named file, or standard input if there isn't
+ * one, writing the result to standard output. Returns the exit status. */
+inline int run(const int argc, char* argv[], const The_Deck::Opmode mode)
+{
+    const auto deck = The_Deck::Deck(The_Deck::Deck::Kind::WITH_JOKERS);
+    FdOutbuf output_buffer(STDOUT_FILENO);
+    std::ostream output(&output_buffer);
+
+    const int fd = argc == 1 ? STDIN_FILENO : ::open(argv[1], O_RDONLY);
+    if (fd < 0) {
+        std::cerr << argv[0] << ": " << argv[1] << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    int error = 0;
+    const auto stream_input = [&] {
+        FdInbuf input_buffer(fd);
+        The_Deck::solitaire(std::istream(&input_buffer), output, deck, mode);
+        error = input_buffer.read_error();
+    };
+    struct stat info {};
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        const auto size = static_cast<size_t>(info.st_size);
+        auto* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            ::madvise(mapped, size, MADV_SEQUENTIAL);
+            The_Deck::solitaire(std::span(static_cast<const char*>(mapped), size),
+                output, deck, mode);
+            ::munmap(mapped, size);
+        } else {
+            stream_input();
+        }
+    } else {
+        stream_input();
+    }
+    if (fd != STDIN_FILENO)
+        ::close(fd);
+    if (error) {
+        output.flush();
+        std::cerr << argv[0] << ": " << (argc == 1 ? "standard input" : argv[1]) << ": "
+                  << std::strerror(error) << "\n";
+        return 1;
+    }
+
+    output << "\n";
+    output.flush();
+    return output ? 0 : 1;
+}
+#else
+/* Windows gets the same shape through its own large stream buffers. */
+inline int run(const int argc, char* argv[], const The_Deck::Opmode mode)
+{
+    const auto deck = The_Deck::Deck(The_Deck::Deck::Kind::WITH_JOKERS);
+    std::vector<char> output_buffer(BUFFER_SIZE);
+    std::ios::sync_with_stdio(false);
+    std::cout.rdbuf()->pubsetbuf(output_buffer.data(), BUFFER_SIZE);
+
+    if (argc == 1) {
+        The_Deck::solitaire(std::cin, std::cout, deck, mode);
+    } else {
+        std::ifstream input(argv[1], std::ios::binary);
+        if (!input) {
+            std::cerr << argv[0] << ": can't open " << argv[1] << "\n";
+            return 1;
+        }
+        The_Deck::solitaire(input, std::cout, deck, mode);
+        if (input.bad()) {
+            std::cerr << argv[0] << ": can't read " << argv[1] << "\n";
+            return 1;
+        }
+    }
+    std::cout << "\n";
+    std::cout.flush();
+    return std::cout ? 0 : 1;
+}
+#endif
+} // namespace Bulk_IO
+#endif
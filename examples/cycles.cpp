@@ -0,0 +1,92 @@
+#include "../decky/the_deck.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+
+using std::cerr;
+using std::size_t;
+using std::vector;
+using The_Deck::CycleLength;
+
+/* Finds the tail and period of the Solitaire state sequence for many
+ * randomly shuffled decks:
+ *
+ *     sol-cycles CARDS DECKS MAX_ROUNDS [SEED]
+ *
+ * CARDS is the deck size, jokers included, from 3 to 54. The report goes
+ * to standard output as tab-separated lines of deck number, starting
+ * deck (as ordinals; the last two are the jokers), tail and period, with
+ * a dash for decks whose cycle wasn't found within MAX_ROUNDS rounds, and
+ * a summary at the end. Progress goes to standard error. */
+
+namespace {
+constexpr size_t DECKS_PER_BATCH = 1024;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4 || argc > 5) {
+        cerr << "usage: " << argv[0] << " CARDS DECKS MAX_ROUNDS [SEED]\n";
+        return 2;
+    }
+
+    try {
+        const auto cards = static_cast<size_t>(std::stoul(argv[1]));
+        const auto decks = static_cast<size_t>(std::stoull(argv[2]));
+        const auto max_rounds = std::stoull(argv[3]);
+        const auto seed = argc > 4 ? std::stoull(argv[4]) : std::random_device {}();
+        std::mt19937_64 random(seed);
+
+        std::printf("# %zu-card decks, seed %llu, at most %llu rounds\n", cards,
+            static_cast<unsigned long long>(seed), static_cast<unsigned long long>(max_rounds));
+        std::printf("# deck\tstart\ttail\tperiod\n");
+
+        size_t found = 0;
+        uint64_t shortest = UINT64_MAX;
+        uint64_t longest = 0;
+        double total = 0;
+        vector<uint8_t> ordinals;
+        for (size_t first = 0; first < decks; first += DECKS_PER_BATCH) {
+            const auto count = std::min(DECKS_PER_BATCH, decks - first);
+            ordinals.resize(count * cards);
+            for (size_t deck = 0; deck < count; deck++) {
+                const auto start = ordinals.begin() + deck * cards;
+                std::iota(start, start + cards, uint8_t { 0 });
+                std::shuffle(start, start + cards, random);
+            }
+
+            const auto results = The_Deck::find_cycles(cards, ordinals, max_rounds);
+            for (size_t deck = 0; deck < count; deck++) {
+                std::printf("%zu\t", first + deck);
+                for (size_t card = 0; card < cards; card++)
+                    std::printf(card ? ",%u" : "%u", ordinals[deck * cards + card]);
+                const auto& result = results[deck];
+                if (!result.found) {
+                    std::printf("\t-\t-\n");
+                    continue;
+                }
+                std::printf("\t%llu\t%llu\n", static_cast<unsigned long long>(result.tail),
+                    static_cast<unsigned long long>(result.period));
+                found += 1;
+                shortest = std::min(shortest, result.period);
+                longest = std::max(longest, result.period);
+                total += static_cast<double>(result.period);
+            }
+            cerr << "\r" << first + count << " of " << decks << " decks" << std::flush;
+        }
+        cerr << "\n";
+
+        std::printf("# %zu of %zu cycles found\n", found, decks);
+        if (found > 0)
+            std::printf("# period: shortest %llu, longest %llu, mean %.1f\n",
+                static_cast<unsigned long long>(shortest), static_cast<unsigned long long>(longest),
+                total / static_cast<double>(found));
+    } catch (const std::exception& error) {
+        cerr << argv[0] << ": " << error.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,25 +1,8 @@
-#include "../decky/the_deck.h"
-#include <fstream>
+#include "bulk_io.h"
 
-using std::cin;
-using std::cout;
-using std::ifstream;
-
-using The_Deck::Deck;
 using The_Deck::Opmode;
-using The_Deck::solitaire;
 
 int main(int argc, char* argv[])
 {
-    auto deck = Deck(Deck::Kind::WITH_JOKERS);
-    auto mode = Opmode::ENCRYPT;
-
-    if (argc == 1) {
-        solitaire(cin, cout, deck, mode);
-    } else {
-        solitaire(ifstream(argv[1]), cout, deck, mode);
-    }
-    cout << "\n";
-
-    return 0;
-}
\ No newline at end of file
+    return Bulk_IO::run(argc, argv, Opmode::ENCRYPT);
+}
@@ -0,0 +1,68 @@
+#include "../decky/the_deck.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+using std::cerr;
+using std::cout;
+using std::ifstream;
+using std::istreambuf_iterator;
+using std::string;
+using The_Deck::SearchProgress;
+
+/* Searches a word list for the passphrase a message was encrypted under,
+ * given a few words it's known to start with:
+ *
+ *     sol-search WORDLIST CRIB [CIPHERTEXT]
+ *
+ * The ciphertext comes from the named file or standard input. Matching
+ * passphrases go to standard output, one per line; progress and
+ * throughput go to standard error as the search runs. */
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || argc > 4) {
+        cerr << "usage: " << argv[0] << " WORDLIST CRIB [CIPHERTEXT]\n";
+        return 2;
+    }
+
+    ifstream words(argv[1], std::ios::binary);
+    if (!words) {
+        cerr << argv[0] << ": can't open " << argv[1] << "\n";
+        return 1;
+    }
+
+    string ciphertext;
+    if (argc == 4) {
+        ifstream input(argv[3], std::ios::binary);
+        if (!input) {
+            cerr << argv[0] << ": can't open " << argv[3] << "\n";
+            return 1;
+        }
+        ciphertext.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+    } else {
+        ciphertext.assign(istreambuf_iterator<char>(std::cin), istreambuf_iterator<char>());
+    }
+
+    const string crib(argv[2]);
+    try {
+        const auto found = The_Deck::search_passphrases(words, ciphertext, crib,
+            [](const SearchProgress& progress) {
+                char line[128];
+                std::snprintf(line, sizeof line, "\r%llu tried, %llu found, %.0f per second",
+                    static_cast<unsigned long long>(progress.candidates),
+                    static_cast<unsigned long long>(progress.matches),
+                    progress.per_second());
+                cerr << line << std::flush;
+            });
+        cerr << "\n";
+        for (const auto& passphrase : found)
+            cout << passphrase << "\n";
+        return found.empty() ? 1 : 0;
+    } catch (const std::invalid_argument& error) {
+        cerr << argv[0] << ": " << error.what() << "\n";
+        return 2;
+    }
+}
@@ -1,8 +1,15 @@
 #include "the_deck.h"
+#include "../examples/bulk_io.h"
 #include <array>
+#include <cmath>
 #include <gtest/gtest.h>
+#include <map>
 #include <print>
 #include <ranges>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
 
 using std::array;
 using std::get;
@@ -31,6 +38,8 @@ TEST(card, lt_incorrect)
 {
     EXPECT_FALSE(Card(0) < Card(0));
     EXPECT_FALSE(Card(1) < Card(0));
+    EXPECT_FALSE(Card(0) < Card(Card::Suit::NONE, Card::Rank::JOKER_A));
+    EXPECT_FALSE(Card(51) < Card(Card::Suit::NONE, Card::Rank::JOKER_B));
     EXPECT_FALSE(Card(Card::Suit::NONE, Card::Rank::JOKER_A) < Card(Card::Suit::NONE, Card::Rank::JOKER_A));
     EXPECT_FALSE(Card(Card::Suit::NONE, Card::Rank::JOKER_B) < Card(Card::Suit::NONE, Card::Rank::JOKER_A));
     EXPECT_FALSE(Card(Card::Suit::NONE, Card::Rank::JOKER_B) < Card(Card::Suit::NONE, Card::Rank::JOKER_B));
@@ -59,6 +68,35 @@ TEST(card, test_card_as_int)
     EXPECT_TRUE(Card(Card::Suit::NONE, Card::Rank::JOKER_B).card_as_int() == 52);
 }
 
+TEST(card, packed_card)
+{
+    static_assert(sizeof(PackedCard) == 1);
+    static_assert(PackedCard(PackedCard::JOKER_B).value() == 53);
+    static_assert(PackedCard(PackedCard::JOKER_A) < PackedCard(0));
+
+    vector<Card> cards;
+    for (int32_t i = 0; i < 52; i++)
+        cards.push_back(Card(i));
+    cards.push_back(Card(Card::Suit::NONE, Card::Rank::JOKER_A));
+    cards.push_back(Card(Card::Suit::NONE, Card::Rank::JOKER_B));
+
+    for (uint8_t i = 0; i < PackedCard::COUNT; i++) {
+        const PackedCard packed(cards[i]);
+        EXPECT_TRUE(packed.ordinal() == i);
+        EXPECT_TRUE(Card(packed) == cards[i]);
+        EXPECT_TRUE(packed.as_int() == cards[i].card_as_int());
+        for (uint8_t j = 0; j < PackedCard::COUNT; j++)
+            EXPECT_TRUE((packed < PackedCard(j)) == (cards[i] < cards[j]));
+    }
+    EXPECT_THROW(PackedCard(PackedCard::COUNT), range_error);
+    EXPECT_THROW(PackedCard(Card(Card::Suit::NONE, Card::Rank::ACE)), std::invalid_argument);
+
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle();
+    const auto packed = deck.packed();
+    EXPECT_TRUE(Deck(std::span<const PackedCard>(packed.data(), packed.size())) == deck);
+}
+
 TEST(deck, default_create)
 {
     auto deck = Deck();
@@ -88,6 +126,30 @@ TEST(deck, copy_range)
     EXPECT_TRUE(deck[0] == Card(0));
 }
 
+TEST(deck, copy_range_too_large)
+{
+    vector<Card> cards(Deck::MAX_CARDS + 1, Card(0));
+    EXPECT_THROW(Deck(std::span<const Card>(cards)), std::length_error);
+}
+
+TEST(deck, copy_is_independent)
+{
+    static_assert(std::is_trivially_copyable_v<Deck>);
+
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    auto copy = deck;
+    copy.deal(0);
+    EXPECT_TRUE(copy.size() == 53);
+    EXPECT_TRUE(deck.size() == 54);
+    EXPECT_TRUE(deck[0] == Card(0));
+}
+
+TEST(deck, insert_when_full)
+{
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    EXPECT_THROW(deck.insert(Card(0), 0), std::length_error);
+}
+
 TEST(deck, random_access)
 {
     auto deck = Deck();
@@ -114,6 +176,38 @@ TEST(deck, shuffle)
     EXPECT_TRUE(deck[0] != Card(0) || deck[13] != Card(13) || deck[26] != Card(26) || deck[39] != Card(39) || deck[51] != Card(51));
 }
 
+TEST(deck, shuffle_with_generator)
+{
+    auto first = Deck(Deck::Kind::WITH_JOKERS);
+    auto second = Deck(Deck::Kind::WITH_JOKERS);
+    first.shuffle(std::mt19937 { 2026 });
+    second.shuffle(std::mt19937 { 2026 });
+    EXPECT_TRUE(first == second);
+    EXPECT_FALSE(first == Deck(Deck::Kind::WITH_JOKERS));
+    EXPECT_NO_THROW(first.triple_cut());
+}
+
+TEST(deck, shuffle_from_many_threads)
+{
+    vector<Deck> decks(8, Deck(Deck::Kind::WITH_JOKERS));
+    vector<std::thread> threads;
+    for (auto& deck : decks)
+        threads.emplace_back([&deck] {
+            for (size_t i = 0; i < 1000; i++)
+                deck.shuffle();
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    auto sorted = Deck(Deck::Kind::WITH_JOKERS);
+    sorted.sort();
+    for (auto& deck : decks) {
+        EXPECT_FALSE(deck == Deck(Deck::Kind::WITH_JOKERS));
+        deck.sort();
+        EXPECT_TRUE(deck == sorted);
+    }
+}
+
 TEST(deck, sort)
 {
     auto deck = Deck();
@@ -321,6 +415,35 @@ TEST(deck, bury_with_wraparound)
     }
 }
 
+TEST(deck, bury_with_wraparound_matches_bury_1)
+{
+    auto joker_b = Card(Card::Suit::NONE, Card::Rank::JOKER_B);
+
+    for (size_t position = 0; position < 54; position++) {
+        for (size_t slots = 0; slots < 110; slots++) {
+            auto deck = Deck();
+            deck.insert(joker_b, static_cast<long>(std::min<size_t>(position, 52)));
+            deck.insert(Card(Card::Suit::NONE, Card::Rank::JOKER_A), 0);
+            auto deck2 = deck;
+
+            deck.bury_with_wraparound(joker_b, slots);
+            for (size_t i = 0; i < slots; i++)
+                deck2.bury_1_with_wraparound(joker_b);
+            EXPECT_TRUE(deck == deck2);
+        }
+    }
+}
+
+TEST(deck, bury_after_tampering)
+{
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    std::swap(deck.deck[0], deck.deck[53]);
+
+    deck.bury_joker_b();
+    EXPECT_TRUE(deck[2] == Card(Card::Suit::NONE, Card::Rank::JOKER_B));
+    EXPECT_TRUE(deck[53] == Card(0));
+}
+
 TEST(deck, bury_joker_a_with_wrap)
 {
     auto joker_a = Card(Card::Suit::NONE, Card::Rank::JOKER_A);
@@ -402,6 +525,90 @@ TEST(deck, count_cut)
     EXPECT_TRUE(deck[53] == Card(9));
 }
 
+TEST(deck, count_cut_short_deck)
+{
+    Card cards[3] = { Card(1), Card(2), Card(40) };
+    auto deck = Deck(cards);
+    deck.count_cut();
+    EXPECT_TRUE(deck[0] == Card(1));
+    EXPECT_TRUE(deck[2] == Card(40));
+
+    Card cards2[4] = { Card(1), Card(2), Card(3), Card(0) };
+    auto deck2 = Deck(cards2);
+    deck2.count_cut();
+    EXPECT_TRUE(deck2[0] == Card(2));
+    EXPECT_TRUE(deck2[2] == Card(1));
+    EXPECT_TRUE(deck2[3] == Card(0));
+}
+
+TEST(deck, deck_code)
+{
+    std::mt19937_64 random(25);
+    std::unordered_set<DeckCode> codes;
+    std::unordered_set<Deck> decks;
+    for (size_t i = 0; i < 200; i++) {
+        auto deck = Deck(i % 2 ? Deck::Kind::WITH_JOKERS : Deck::Kind::WITHOUT_JOKERS);
+        deck.shuffle(random);
+        while (deck.size() > i % 10 * 6)
+            deck.deal(0);
+        const auto code = deck.code();
+        EXPECT_EQ(code.cards, deck.size());
+        EXPECT_TRUE(Deck(code) == deck);
+        EXPECT_EQ(std::hash<Deck>()(Deck(code)), std::hash<Deck>()(deck));
+        codes.insert(code);
+        decks.insert(deck);
+        decks.insert(Deck(code));
+    }
+    EXPECT_EQ(codes.size(), decks.size());
+
+    // The unshuffled deck is arrangement zero, and the last arrangement
+    // fits in the code.
+    const auto sorted = Deck(Deck::Kind::WITH_JOKERS);
+    EXPECT_TRUE(std::ranges::all_of(sorted.code().lehmer, [](const uint8_t byte) { return byte == 0; }));
+    auto reversed = sorted;
+    std::ranges::reverse(reversed.deck);
+    EXPECT_TRUE(Deck(reversed.code()) == reversed);
+    EXPECT_TRUE(sorted.code() < reversed.code());
+
+    // Codes order as numbers, so a high byte outweighs any low one.
+    auto last_two_swapped = sorted;
+    std::swap(last_two_swapped.deck[52], last_two_swapped.deck[53]);
+    auto first_two_swapped = sorted;
+    std::swap(first_two_swapped.deck[0], first_two_swapped.deck[1]);
+    EXPECT_EQ(last_two_swapped.code().lehmer[0], 1);
+    EXPECT_TRUE(last_two_swapped.code() < first_two_swapped.code());
+    DeckCode small;
+    small.cards = 54;
+    small.lehmer[0] = 0xFF;
+    small.lehmer[1] = 1;
+    DeckCode large = small;
+    large.lehmer[0] = 1;
+    large.lehmer[1] = 2;
+    EXPECT_TRUE(small < large);
+    EXPECT_TRUE(large > small);
+    EXPECT_TRUE((small <=> small) == 0);
+    large.cards = 53;
+    EXPECT_TRUE(large < small);
+    EXPECT_TRUE(Deck(DeckCode {}) == Deck(std::span<const Card>()));
+
+    // A deck and its own first few cards are different decks.
+    const auto without_jokers = Deck();
+    EXPECT_FALSE(without_jokers == sorted);
+    EXPECT_NE(without_jokers.code(), sorted.code());
+    EXPECT_NE(without_jokers.hash(), sorted.hash());
+
+    DeckCode too_many;
+    too_many.cards = Deck::MAX_CARDS + 1;
+    EXPECT_THROW(Deck { too_many }, std::invalid_argument);
+    DeckCode too_large;
+    too_large.cards = 1;
+    too_large.lehmer[0] = Deck::MAX_CARDS;
+    EXPECT_THROW(Deck { too_large }, std::invalid_argument);
+    auto duplicated = Deck();
+    duplicated[1] = duplicated[0];
+    EXPECT_THROW((void)duplicated.code(), std::invalid_argument);
+}
+
 TEST(deck, get_keystream_value)
 {
     auto deck = Deck(Deck::Kind::WITH_JOKERS);
@@ -451,6 +658,81 @@ TEST(solitaire_ks, keystream_generation)
         [](const auto& x) { return get<0>(x) == get<1>(x); }));
 }
 
+TEST(solitaire_ks, engine_matches_deck_operations)
+{
+    for (int trial = 0; trial < 20; trial++) {
+        auto deck = Deck(Deck::Kind::WITH_JOKERS);
+        deck.shuffle();
+        KeystreamEngine engine(deck);
+
+        for (int i = 0; i < 500; i++) {
+            deck.bury_joker_a();
+            deck.bury_joker_b();
+            deck.triple_cut();
+            deck.count_cut();
+            EXPECT_TRUE(engine.step() == deck.get_keystream_value());
+            EXPECT_TRUE(engine.deck() == deck);
+        }
+    }
+}
+
+TEST(solitaire_ks, deck_steps_in_place)
+{
+    std::mt19937 random(4);
+    for (int trial = 0; trial < 20; trial++) {
+        auto deck = Deck(Deck::Kind::WITH_JOKERS);
+        deck.shuffle(random);
+        KeystreamEngine engine(deck);
+
+        for (int i = 0; i < 200; i++) {
+            EXPECT_EQ(get_raw_keystream_value(deck), engine.next_raw());
+            EXPECT_TRUE(deck == engine.deck());
+        }
+        // The deck's own operations still find their cards afterwards.
+        auto stepped = engine.deck();
+        deck.bury_joker_b();
+        deck.triple_cut();
+        stepped.bury_joker_b();
+        stepped.triple_cut();
+        EXPECT_TRUE(deck == stepped);
+    }
+
+    auto no_jokers = Deck();
+    EXPECT_THROW(get_raw_keystream_value(no_jokers), logic_error);
+}
+
+TEST(solitaire_ks, engine_needs_jokers)
+{
+    EXPECT_THROW(KeystreamEngine { Deck() }, logic_error);
+
+    auto deck = Deck();
+    deck.insert(Card(Card::Suit::NONE, Card::Rank::JOKER_A), 0);
+    deck.insert(Card(Card::Suit::NONE, Card::Rank::JOKER_A), 0);
+    EXPECT_THROW(KeystreamEngine { deck }, logic_error);
+}
+
+TEST(solitaire_ks, generator_batches)
+{
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle();
+    auto deck2 = deck;
+
+    KeystreamGenerator raw(deck);
+    KeystreamGenerator mod26(deck);
+    vector<uint8_t> raw_values(1000);
+    vector<uint8_t> values(1000);
+    // Odd-sized batches have to pick up exactly where the last left off.
+    raw.generate_raw(std::span(raw_values).first(7));
+    raw.generate_raw(std::span(raw_values).subspan(7));
+    mod26.generate(values);
+
+    for (size_t i = 0; i < raw_values.size(); i++) {
+        EXPECT_TRUE(raw_values[i] == get_raw_keystream_value(deck));
+        EXPECT_TRUE(values[i] == get_keystream_value(deck2));
+    }
+    EXPECT_TRUE(raw.deck() == deck);
+}
+
 TEST(solitaire_ks, convert_string_to_numbers)
 {
     const array<uint8_t, 10> correct_result = { 4, 15, 14, 15, 20,
@@ -460,6 +742,73 @@ TEST(solitaire_ks, convert_string_to_numbers)
         [](const auto& x) { return get<0>(x) == get<1>(x); }));
 }
 
+TEST(solitaire_ks, normalize_letters)
+{
+    std::mt19937 gen { 12345 };
+    std::uniform_int_distribution<int> byte { 0, 255 };
+    std::uniform_int_distribution<int> letter { 'A', 'z' };
+
+    for (size_t size = 0; size < 300; size += (size < 70 ? 1 : 37)) {
+        for (int mostly_letters = 0; mostly_letters < 2; mostly_letters++) {
+            string input(size, '\0');
+            for (auto& c : input)
+                c = static_cast<char>(mostly_letters ? letter(gen) : byte(gen));
+
+            vector<uint8_t> expected;
+            for (const auto c : input) {
+                if (c >= 'a' && c <= 'z')
+                    expected.push_back(static_cast<uint8_t>(c - 'a' + 1));
+                else if (c >= 'A' && c <= 'Z')
+                    expected.push_back(static_cast<uint8_t>(c - 'A' + 1));
+            }
+
+            vector<uint8_t> output(size);
+            output.resize(normalize_letters(input, output));
+            EXPECT_TRUE(output == expected);
+        }
+    }
+
+    vector<uint8_t> too_small(3);
+    EXPECT_THROW(normalize_letters(string("abcd"), too_small), std::length_error);
+}
+
+TEST(solitaire_ks, combine_keystream)
+{
+    // Every pairing of letter and keystream value, at a length that
+    // exercises the vector and scalar paths alike.
+    vector<uint8_t> values;
+    vector<uint8_t> key;
+    for (uint8_t v = 1; v <= 26; v++) {
+        for (uint8_t k = 1; k <= 26; k++) {
+            values.push_back(v);
+            key.push_back(k);
+        }
+    }
+
+    vector<uint8_t> ciphertext(values.size());
+    vector<uint8_t> plaintext(values.size());
+    combine_keystream(values, key, ciphertext, Opmode::ENCRYPT);
+    for (auto& c : ciphertext)
+        c = static_cast<uint8_t>(c - 'A' + 1);
+    combine_keystream(ciphertext, key, plaintext, Opmode::DECRYPT);
+
+    for (size_t i = 0; i < values.size(); i++) {
+        EXPECT_TRUE(ciphertext[i] == (values[i] + key[i] - 1) % 26 + 1);
+        EXPECT_TRUE(plaintext[i] == values[i] + 'A' - 1);
+    }
+}
+
+TEST(solitaire_ks, round_trip_every_letter)
+{
+    const string plaintext { "ABCDEFGHIJKLMNOPQRSTUVWXYZZZZZ" };
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle();
+
+    auto result = decrypt(encrypt(plaintext, deck), deck);
+    std::erase(result, ' ');
+    EXPECT_TRUE(result == plaintext);
+}
+
 TEST(solitaire_ks, convert_numbers_to_string)
 {
     const vector<uint8_t> input_vector { 4, 15, 14, 15, 20, 21, 19, 5, 16, 3 };
@@ -515,3 +864,577 @@ TEST(solitaire_ks, decrypt)
     EXPECT_TRUE(result == expected_result);
     EXPECT_TRUE(deck == Deck(Deck::Kind::WITH_JOKERS));
 }
+
+TEST(solitaire_ks, keystream_cache)
+{
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle();
+    const string short_message { "Meet me at the usual place." };
+    const string long_message(500, 'q');
+    const auto short_expected = encrypt(short_message, deck);
+    const auto long_expected = encrypt(long_message, deck);
+
+    set_keystream_cache_capacity(4, 100);
+    EXPECT_TRUE(keystream_cache_capacity() == 4);
+    // Short, then long enough to extend the prefix and run past its
+    // limit, then short again.
+    EXPECT_TRUE(encrypt(short_message, deck) == short_expected);
+    EXPECT_TRUE(encrypt(long_message, deck) == long_expected);
+    EXPECT_TRUE(encrypt(short_message, deck) == short_expected);
+    EXPECT_TRUE(decrypt(short_expected, deck).starts_with("MEETM"));
+
+    vector<std::thread> threads;
+    vector<string> results(8);
+    for (size_t i = 0; i < results.size(); i++)
+        threads.emplace_back([&, i] {
+            auto other = Deck(Deck::Kind::WITH_JOKERS);
+            for (int j = 0; j < 50; j++)
+                results[i] = encrypt(i % 2 ? long_message : short_message,
+                    j % 3 ? deck : other);
+        });
+    for (auto& thread : threads)
+        thread.join();
+    for (size_t i = 0; i < results.size(); i++)
+        EXPECT_TRUE(results[i] == (i % 2 ? long_expected : short_expected));
+
+    set_keystream_cache_capacity(0);
+    EXPECT_TRUE(keystream_cache_capacity() == 0);
+}
+
+TEST(solitaire_ks, solitaire_uses_keystream_cache)
+{
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle();
+    const string short_message { "Meet me at the usual place." };
+    const string long_message(500, 'q');
+    const auto short_expected = encrypt(short_message, deck);
+    const auto long_expected = encrypt(long_message, deck);
+    const auto run = [&](const string& message) {
+        std::ostringstream output;
+        solitaire(std::istringstream(message), output, deck, Opmode::ENCRYPT);
+        return output.str();
+    };
+
+    set_keystream_cache_capacity(4, 100);
+    reset_stats();
+    // The first run fills the cache and runs past the end of what it
+    // keeps; the rest start from it.
+    EXPECT_EQ(run(long_message), long_expected);
+    EXPECT_EQ(run(long_message), long_expected);
+    EXPECT_EQ(run(short_message), short_expected);
+    EXPECT_EQ(encrypt(short_message, deck), short_expected);
+    const auto stats = stats_snapshot();
+
+    // A context fed a few letters at a time runs off the end of the
+    // cached values partway through a piece.
+    SolitaireContext context(deck, Opmode::ENCRYPT);
+    string pieces;
+    for (size_t i = 0; i < long_message.size(); i += 7)
+        context.update(std::span(long_message).subspan(i, std::min<size_t>(7, long_message.size() - i)), pieces);
+    context.finalize(pieces);
+    EXPECT_EQ(pieces, long_expected);
+    set_keystream_cache_capacity(0);
+
+    if (!stats.enabled)
+        return;
+    EXPECT_EQ(stats.keystream_cache_misses, 1);
+    EXPECT_EQ(stats.keystream_cache_hits, 3);
+    // Only the first run steps through the cached hundred values.
+    EXPECT_EQ(stats.keystream_steps - stats.joker_rejections, 500 + 400);
+}
+
+TEST(solitaire_ks, stream_matches_one_shot)
+{
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle();
+
+    // Long enough to cross several chunk boundaries, with a letter count
+    // that isn't a multiple of five.
+    string plaintext;
+    while (plaintext.size() < 200000)
+        plaintext += "Attack at dawn, 0600 hours; bring snacks!\n";
+    plaintext += "xy";
+
+    for (const auto mode : { Opmode::ENCRYPT, Opmode::DECRYPT }) {
+        std::ostringstream output;
+        solitaire(std::istringstream(plaintext), output, deck, mode);
+        EXPECT_TRUE(output.str() == crypt(plaintext, deck, mode));
+    }
+
+    std::ostringstream from_span;
+    solitaire(std::span<const char>(plaintext), from_span, deck, Opmode::ENCRYPT);
+    EXPECT_TRUE(from_span.str() == crypt(plaintext, deck, Opmode::ENCRYPT));
+
+    std::ostringstream empty;
+    solitaire(std::istringstream("1234 !!"), empty, deck, Opmode::ENCRYPT);
+    EXPECT_TRUE(empty.str().empty());
+}
+
+#ifndef _WIN32
+TEST(solitaire_ks, bulk_io_read_error)
+{
+    // A directory opens, but reading from it fails.
+    const int fd = ::open(".", O_RDONLY);
+    ASSERT_GE(fd, 0);
+    Bulk_IO::FdInbuf buffer(fd);
+    std::istream input(&buffer);
+    EXPECT_EQ(input.get(), std::istream::traits_type::eof());
+    EXPECT_EQ(buffer.read_error(), EISDIR);
+    ::close(fd);
+}
+#endif
+
+TEST(solitaire_ks, context_matches_one_shot)
+{
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle();
+    string plaintext;
+    while (plaintext.size() < 100000)
+        plaintext += "Meet me by the old oak tree at 9, and come alone. ";
+    plaintext += "Z";
+
+    for (const auto mode : { Opmode::ENCRYPT, Opmode::DECRYPT }) {
+        SolitaireContext context(deck, mode);
+        string output;
+        // Piece sizes that split words, groups and lines every which way.
+        for (size_t at = 0, piece = 1; at < plaintext.size(); at += piece, piece = piece * 7 % 1009)
+            context.update(std::span<const char>(plaintext).subspan(at, std::min(piece, plaintext.size() - at)), output);
+        context.finalize(output);
+        EXPECT_TRUE(output == crypt(plaintext, deck, mode));
+        EXPECT_TRUE(context.letters() % 5 == 0);
+        EXPECT_THROW(context.update(std::span<const char>(plaintext), output), logic_error);
+        EXPECT_THROW(context.finalize(output), logic_error);
+    }
+
+    SolitaireContext empty(deck, Opmode::ENCRYPT);
+    string output;
+    empty.update(std::span<const char>("... 42 ..."), output);
+    empty.finalize(output);
+    EXPECT_TRUE(output.empty());
+}
+
+TEST(solitaire_ks, crypt_batch)
+{
+    vector<string> messages;
+    vector<Deck> decks;
+    for (size_t i = 0; i < 200; i++) {
+        messages.push_back(string(i * 37 % 501, 'a' + i % 26) + " hello, world");
+        decks.push_back(Deck(Deck::Kind::WITH_JOKERS));
+        decks.back().shuffle();
+    }
+
+    for (const size_t threads : { 1, 4 }) {
+        set_batch_threads(threads);
+        EXPECT_TRUE(batch_threads() == threads);
+
+        vector<string> outputs(messages.size());
+        vector<CryptJob> jobs(messages.size());
+        for (size_t i = 0; i < jobs.size(); i++) {
+            outputs[i].resize(crypt_output_bound(messages[i].size()));
+            jobs[i] = { messages[i], decks[i], i % 2 ? Opmode::DECRYPT : Opmode::ENCRYPT, outputs[i] };
+        }
+        crypt_batch(jobs);
+        for (size_t i = 0; i < jobs.size(); i++)
+            EXPECT_TRUE(outputs[i].substr(0, jobs[i].written) == crypt(messages[i], decks[i], jobs[i].mode));
+
+        // A short buffer is caught before anything runs, and a bad deck
+        // surfaces from whichever thread ran it.
+        jobs[7].output = jobs[7].output.first(3);
+        EXPECT_THROW(crypt_batch(jobs), std::length_error);
+        jobs[7].output = outputs[7];
+        jobs[150].deck = Deck();
+        EXPECT_THROW(crypt_batch(jobs), logic_error);
+    }
+    set_batch_threads(0);
+}
+
+TEST(solitaire_ks, keystream_index)
+{
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle();
+    vector<uint8_t> expected(5000);
+    KeystreamGenerator(deck).generate(expected);
+
+    KeystreamIndex index(deck, 64);
+    index.extend(1000);
+    EXPECT_TRUE(index.letters() >= 1000 && index.checkpoints() == 16);
+    for (const uint64_t position : { 0, 1, 63, 64, 999, 1024, 4321 }) {
+        uint8_t value;
+        index.seek(position).generate(std::span(&value, 1));
+        EXPECT_TRUE(value == expected[position]);
+    }
+
+    // Checkpoints taken while encrypting, after a round trip through the
+    // sidecar form, decrypt the message in parallel segments.
+    string plaintext;
+    while (plaintext.size() < 20000)
+        plaintext += "The quick brown fox jumps over the lazy dog. ";
+    SolitaireContext context(deck, Opmode::ENCRYPT, 100);
+    string ciphertext;
+    context.update(std::span<const char>(plaintext), ciphertext);
+    context.finalize(ciphertext);
+    EXPECT_TRUE(context.checkpoints().letters() >= context.letters() - 100);
+
+    const auto sidecar = KeystreamIndex::deserialize(context.checkpoints().serialize());
+    set_batch_threads(4);
+    EXPECT_TRUE(crypt_indexed(ciphertext, sidecar, Opmode::DECRYPT) == crypt(ciphertext, deck, Opmode::DECRYPT));
+    EXPECT_TRUE(crypt_indexed(plaintext, KeystreamIndex(deck, 77), Opmode::ENCRYPT) == ciphertext);
+    set_batch_threads(0);
+
+    auto corrupt = context.checkpoints().serialize();
+    corrupt[12] = corrupt[13];
+    EXPECT_THROW(KeystreamIndex::deserialize(corrupt), std::invalid_argument);
+    EXPECT_THROW(KeystreamIndex(deck, 0), std::invalid_argument);
+    if constexpr (sizeof(size_t) > 4) {
+        EXPECT_THROW(KeystreamIndex(deck, size_t { 1 } << 32), std::invalid_argument);
+        EXPECT_THROW(SolitaireContext(deck, Opmode::ENCRYPT, size_t { 1 } << 32), std::invalid_argument);
+    }
+    EXPECT_THROW((void)SolitaireContext(deck, Opmode::ENCRYPT).checkpoints(), logic_error);
+}
+
+TEST(solitaire_ks, key_deck)
+{
+    // Schneier's published test vectors.
+    EXPECT_TRUE(encrypt("AAAAAAAAAAAAAAA", key_deck(string("foo"))) == "ITHZU JIWGR FARMW");
+    EXPECT_TRUE(encrypt("SOLITAIRE", key_deck(string("cryptonomicon"))) == "KIRAK SFJAN");
+
+    // An empty passphrase leaves the deck in order.
+    EXPECT_TRUE(key_deck(string("1234")) == Deck(Deck::Kind::WITH_JOKERS));
+
+    set_key_cache_capacity(2);
+    EXPECT_TRUE(key_cache_capacity() == 2);
+    const auto first = key_deck(string("Correct horse"));
+    EXPECT_TRUE(key_deck(string("CORRECT HORSE!")) == first);
+    EXPECT_TRUE(key_deck(string("battery staple")) == key_deck(string("batterystaple")));
+    EXPECT_TRUE(key_deck(string("correcthorse")) == first);
+    set_key_cache_capacity(0);
+}
+
+TEST(solitaire_ks, stats_snapshot)
+{
+    reset_stats();
+    const auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    const auto ciphertext = encrypt("Hello, world", deck);
+    decrypt(ciphertext, deck);
+    std::ostringstream output;
+    solitaire(std::istringstream("Hello"), output, deck, Opmode::ENCRYPT);
+
+    const auto stats = stats_snapshot();
+    const auto json = stats.to_json();
+    EXPECT_TRUE(json.front() == '{' && json.back() == '}');
+    if (!stats.enabled) {
+        EXPECT_TRUE(stats.keystream_steps == 0 && stats.encrypt.calls == 0);
+        return;
+    }
+    EXPECT_TRUE(stats.encrypt.calls == 1 && stats.decrypt.calls == 1 && stats.solitaire.calls == 1);
+    EXPECT_TRUE(stats.keystream_steps == stats.joker_rejections + 25);
+    EXPECT_TRUE(stats.bytes_in == 12 + ciphertext.size() + 5);
+    EXPECT_TRUE(stats.bytes_out == 2 * ciphertext.size() + 5);
+    EXPECT_TRUE(json.find("\"keystream_steps\":" + std::to_string(stats.keystream_steps)) != string::npos);
+
+    // Counts from threads that have exited are kept.
+    std::thread([&] { encrypt("abcde", deck); }).join();
+    EXPECT_TRUE(stats_snapshot().encrypt.calls == 2);
+    reset_stats();
+    EXPECT_TRUE(stats_snapshot().keystream_steps == 0);
+}
+
+TEST(solitaire_ks, format_groups)
+{
+    string letters(203, 'A');
+    for (size_t i = 0; i < letters.size(); i++)
+        letters[i] = static_cast<char>('A' + i % 26);
+    const auto values = std::span(reinterpret_cast<const uint8_t*>(letters.data()), letters.size());
+
+    // The traditional layout, built a character at a time.
+    string expected;
+    for (size_t i = 0; i < letters.size(); i++) {
+        if (i && i % 40 == 0)
+            expected += '\n';
+        else if (i && i % 5 == 0)
+            expected += ' ';
+        expected += letters[i];
+    }
+
+    // Formatting in uneven pieces joins up into the same thing.
+    string output;
+    for (size_t at = 0, piece = 3; at < letters.size(); at += piece, piece += 4) {
+        const auto part = values.subspan(at, std::min(piece, letters.size() - at));
+        string buffer(part.size() + part.size() / 5 + 1, '\0');
+        buffer.resize(format_groups(part, at, buffer));
+        output += buffer;
+    }
+    EXPECT_TRUE(output == expected);
+
+    string small(10, '\0');
+    EXPECT_THROW(format_groups(values.first(10), 0, std::span(small).first(11 - 2)), std::length_error);
+}
+
+TEST(solitaire_ks, raw_output_formats)
+{
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle();
+    const string plaintext = "Raw output for machines, please: no grouping at all.";
+    auto grouped = crypt(plaintext, deck, Opmode::ENCRYPT);
+    const auto letters = crypt(plaintext, deck, Opmode::ENCRYPT, OutputFormat::LETTERS);
+    const auto values = crypt(plaintext, deck, Opmode::ENCRYPT, OutputFormat::VALUES);
+
+    std::erase_if(grouped, [](const char c) { return c == ' ' || c == '\n'; });
+    EXPECT_TRUE(letters == grouped);
+    ASSERT_TRUE(values.size() == letters.size());
+    for (size_t i = 0; i < values.size(); i++)
+        EXPECT_TRUE(values[i] == letters[i] - 'A' + 1);
+
+    SolitaireContext context(deck, Opmode::ENCRYPT, OutputFormat::LETTERS);
+    string output;
+    context.update(std::span<const char>(plaintext).first(7), output);
+    context.update(std::span<const char>(plaintext).subspan(7), output);
+    context.finalize(output);
+    EXPECT_TRUE(output == letters);
+}
+
+namespace {
+// Calls `check` for each of the sizes in turn, with the size as a
+// compile-time constant and a generator seeded from it, so every size
+// gets its own repeatable decks.
+template <size_t... Sizes, typename Check>
+void check_each_size(const Check& check)
+{
+    (check(std::integral_constant<size_t, Sizes> {}, std::mt19937(static_cast<uint32_t>(Sizes))), ...);
+}
+}
+
+TEST(solitaire_ks, sized_deck)
+{
+    static_assert(SizedDeck<>::SIZE == Deck::MAX_CARDS);
+    static_assert([] {
+        SizedDeck<5> deck;
+        return deck.next_raw();
+    }() <= 3);
+
+    // Steps two copies of a shuffled deck side by side, one through the
+    // four separate operations and one through the fused step.
+    check_each_size<3, 4, 10, 28, 54>([](const auto size, std::mt19937 random) {
+        constexpr size_t N = decltype(size)::value;
+        for (int trial = 0; trial < 20; trial++) {
+            SizedDeck<N> fused;
+            fused.shuffle(random);
+            auto separate = fused;
+            for (int round = 0; round < 500; round++) {
+                separate.bury_joker_a();
+                separate.bury_joker_b();
+                separate.triple_cut();
+                separate.count_cut();
+                const auto top = SizedDeck<N>::value(separate.ordinals()[0]);
+                const auto expected = SizedDeck<N>::value(separate.ordinals()[top]);
+                const auto same = fused.step() == expected && fused == separate;
+                EXPECT_TRUE(same);
+                if (!same)
+                    return;
+            }
+        }
+    });
+
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle(std::mt19937 { 54 });
+    SizedDeck<> sized(deck);
+    EXPECT_TRUE(sized.deck() == deck);
+
+    KeystreamGenerator generator(deck);
+    vector<uint8_t> expected(2000);
+    vector<uint8_t> actual(2000);
+    generator.generate(expected);
+    sized.generate(actual);
+    EXPECT_TRUE(actual == expected);
+    EXPECT_TRUE(sized.deck() == generator.deck());
+
+    EXPECT_THROW((SizedDeck<4>({ 0, 1, 1, 3 })), std::invalid_argument);
+    EXPECT_THROW(SizedDeck<> { Deck() }, std::invalid_argument);
+}
+
+TEST(solitaire_ks, search_passphrases)
+{
+    // Enough words for two batches, with the passphrase (spelled two ways)
+    // in the second.
+    std::ostringstream list;
+    for (int i = 0; i < 70000; i++) {
+        list << "word" << i << "\n";
+        if (i == 68000)
+            list << "cryptonomicon\nCrypto-Nomicon\r\n";
+    }
+    std::istringstream words(list.str());
+
+    vector<SearchProgress> reports;
+    const auto found = search_passphrases(words, string("KIRAK SFJAN"), string("solitaire"),
+        [&](const SearchProgress& progress) { reports.push_back(progress); });
+    EXPECT_TRUE(found == vector<string>({ "cryptonomicon", "Crypto-Nomicon" }));
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(reports.back().candidates, 70002);
+    EXPECT_EQ(reports.back().matches, 2);
+
+    std::istringstream none("foo\n");
+    EXPECT_THROW(search_passphrases(none, string("KIRAK"), string("123")), std::invalid_argument);
+    EXPECT_THROW(search_passphrases(none, string("KIRAK"), string("SOLITAIRE")), std::invalid_argument);
+}
+
+TEST(solitaire_ks, analyze_keystream)
+{
+    KeystreamAnalysis analysis;
+    analysis.seed = 2026;
+    analysis.values_per_deck = 5000;
+    size_t checkpoints = 0;
+    analyze_keystream(analysis, 40, [&](const KeystreamAnalysis&) { checkpoints++; });
+    EXPECT_GE(checkpoints, 1);
+    EXPECT_EQ(analysis.decks, 40);
+    EXPECT_EQ(analysis.samples, 200000);
+
+    // Every value is counted once, and every value after the first in a
+    // deck once more as the second half of a bigram.
+    uint64_t unigrams = 0;
+    uint64_t bigrams = 0;
+    for (const auto count : analysis.unigrams)
+        unigrams += count;
+    for (const auto count : analysis.bigrams)
+        bigrams += count;
+    EXPECT_EQ(unigrams, analysis.samples);
+    EXPECT_EQ(bigrams, analysis.samples - analysis.decks);
+    EXPECT_EQ(analysis.unigram_chi_square().degrees_of_freedom, 25);
+    EXPECT_LT(analysis.unigram_chi_square().z_score(), 6);
+
+    // The first deck's keystream, counted by hand.
+    KeystreamAnalysis one;
+    one.seed = 2026;
+    one.values_per_deck = 5000;
+    analyze_keystream(one, 1);
+    std::seed_seq sequence { 2026u, 0u, 0u, 0u };
+    std::mt19937_64 generator(sequence);
+    auto deck = Deck(Deck::Kind::WITH_JOKERS);
+    deck.shuffle(generator);
+    vector<uint8_t> keystream(5000);
+    KeystreamGenerator(deck).generate(keystream);
+    array<uint64_t, 26> unigram_counts {};
+    for (const auto value : keystream)
+        unigram_counts[value - 1]++;
+    EXPECT_TRUE(one.unigrams == unigram_counts);
+
+    // Stopping and resuming gives the same counts as one unbroken run.
+    auto resumed = KeystreamAnalysis::deserialize(one.serialize());
+    EXPECT_TRUE(resumed.unigrams == one.unigrams);
+    analyze_keystream(resumed, 40);
+    EXPECT_TRUE(resumed.serialize() == analysis.serialize());
+
+    // Uniform values in short runs fit the gap distribution, long gaps
+    // and all.
+    KeystreamAnalysis uniform;
+    uniform.values_per_deck = 100;
+    std::mt19937 random(22);
+    for (uniform.decks = 0; uniform.decks < 20000; uniform.decks++) {
+        array<uint64_t, 26> last {};
+        for (uint64_t position = 1; position <= uniform.values_per_deck; position++) {
+            const auto value = random() % 26;
+            if (last[value] > 0)
+                uniform.gaps[std::min<uint64_t>(position - last[value], KeystreamAnalysis::GAP_BUCKETS) - 1]++;
+            last[value] = position;
+        }
+    }
+    EXPECT_LT(std::abs(uniform.gap_chi_square().z_score()), 4);
+
+    EXPECT_THROW((void)KeystreamAnalysis::deserialize(vector<uint8_t>(10)), std::invalid_argument);
+    EXPECT_THROW(analyze_keystream(resumed = KeystreamAnalysis(), 1), std::invalid_argument);
+}
+
+TEST(solitaire_ks, lane_engine)
+{
+    check_each_size<8, 16, 32>([](const auto width, std::mt19937 random) {
+        constexpr size_t Lanes = decltype(width)::value;
+        vector<Deck> decks;
+        for (size_t lane = 0; lane < Lanes; lane++) {
+            decks.push_back(Deck(Deck::Kind::WITH_JOKERS));
+            decks.back().shuffle(random);
+        }
+
+        // Single rounds, jokers and all.
+        LaneEngine<Lanes> stepped(decks);
+        vector<KeystreamEngine> engines;
+        for (const auto& deck : decks)
+            engines.emplace_back(deck);
+        for (int round = 0; round < 200; round++) {
+            const auto values = stepped.step();
+            for (size_t lane = 0; lane < Lanes; lane++)
+                EXPECT_TRUE(values[lane] == engines[lane].step());
+        }
+
+        // Keystream in two helpings, which must carry on from each other.
+        LaneEngine<Lanes> lanes(decks);
+        vector<uint8_t> first(Lanes * 1000);
+        vector<uint8_t> second(Lanes * 37);
+        lanes.generate(first);
+        lanes.generate(second);
+        for (size_t lane = 0; lane < Lanes; lane++) {
+            KeystreamGenerator generator(decks[lane]);
+            vector<uint8_t> expected(1037);
+            generator.generate(expected);
+            EXPECT_TRUE(std::equal(expected.begin(), expected.begin() + 1000, first.begin() + lane * 1000));
+            EXPECT_TRUE(std::equal(expected.begin() + 1000, expected.end(), second.begin() + lane * 37));
+            EXPECT_TRUE(lanes.deck(lane) == generator.deck());
+        }
+    });
+
+    vector<Deck> decks(8, Deck(Deck::Kind::WITH_JOKERS));
+    LaneEngine<8> lanes(decks);
+    vector<uint8_t> uneven(12);
+    EXPECT_THROW(lanes.generate(uneven), std::length_error);
+    EXPECT_THROW((void)lanes.deck(8), std::out_of_range);
+    EXPECT_THROW(LaneEngine<16> { decks }, std::invalid_argument);
+    decks[3] = Deck(Deck::Kind::WITHOUT_JOKERS);
+    EXPECT_THROW(LaneEngine<8> { decks }, std::invalid_argument);
+}
+
+namespace {
+// The tail and period the long way, remembering every state.
+template <size_t N>
+CycleLength brute_force_cycle(SizedDeck<N> deck)
+{
+    std::map<array<uint8_t, N>, uint64_t> seen;
+    for (uint64_t round = 0;; round++) {
+        const auto [at, fresh] = seen.emplace(deck.ordinals(), round);
+        if (!fresh)
+            return { at->second, round - at->second, true };
+        deck.step();
+    }
+}
+}
+
+TEST(solitaire_ks, find_cycle)
+{
+    check_each_size<3, 5, 8, 10>([](const auto size, std::mt19937 random) {
+        constexpr size_t N = decltype(size)::value;
+        vector<uint8_t> ordinals;
+        vector<CycleLength> expected;
+        for (int trial = 0; trial < 20; trial++) {
+            SizedDeck<N> deck;
+            deck.shuffle(random);
+            ordinals.insert(ordinals.end(), deck.ordinals().begin(), deck.ordinals().end());
+            expected.push_back(brute_force_cycle(deck));
+            const auto cycle = find_cycle(deck, 1 << 20);
+            EXPECT_TRUE(cycle.found);
+            EXPECT_EQ(cycle.tail, expected.back().tail);
+            EXPECT_EQ(cycle.period, expected.back().period);
+        }
+        const auto cycles = find_cycles(N, ordinals, 1 << 20);
+        EXPECT_EQ(cycles.size(), expected.size());
+        for (size_t i = 0; i < std::min(cycles.size(), expected.size()); i++) {
+            EXPECT_EQ(cycles[i].tail, expected[i].tail);
+            EXPECT_EQ(cycles[i].period, expected[i].period);
+        }
+    });
+
+    // A full deck's cycle is far too long to find in a hundred rounds.
+    const auto cycle = find_cycle(SizedDeck<>(), 100);
+    EXPECT_FALSE(cycle.found);
+    EXPECT_EQ(cycle.period, 0);
+
+    EXPECT_THROW(find_cycles(2, vector<uint8_t>(4), 10), std::invalid_argument);
+    EXPECT_THROW(find_cycles(5, vector<uint8_t>(7), 10), std::invalid_argument);
+    EXPECT_THROW(find_cycles(3, vector<uint8_t>(3), 10), std::invalid_argument);
+}